@@ -0,0 +1,117 @@
+// Asynchronous entropy conversion using C++20 coroutines.
+// co_await c.convert_async(a, b) uses buffered entropy immediately, and when it needs
+// more input, suspends the coroutine until the source delivers, without blocking a thread.
+//
+// A Source is a non-blocking generator with min(), max() and bool try_generate(result_type & x),
+// and a member function when_ready(fn), which calls fn() once when more input may be available,
+// for example from a producer thread filling a queue. econv::io_uring_entropy_source is a Source
+// that calls fn() from its process_completions() when a read completes.
+// The coroutine resumes on the thread that calls fn(), and the converter must not be
+// used concurrently.
+//
+// Example:
+//
+// econv::async_entropy_converter<my_source> c(source);
+// auto roll = co_await c.convert_async(1, 6);
+//
+// This header requires a compiler with coroutines, such as g++ --std=c++20,
+// and is empty otherwise.
+
+#pragma once
+
+#include "entropy_converter.hpp"
+#include <cstdint>
+
+#if defined(__cpp_impl_coroutine)
+#include <coroutine>
+
+namespace econv
+{
+	// Converts entropy from an asynchronous Source, using an entropy_converter.
+	// The source must outlive the async_entropy_converter.
+	template<typename Source, typename Converter = entropy_converter<std::uint64_t>>
+	class async_entropy_converter
+	{
+	public:
+		typedef typename Converter::result_type result_type;
+
+		explicit async_entropy_converter(Source & source) : source(source) { }
+
+		// The awaitable result of convert_async.
+		class awaiter
+		{
+		public:
+			awaiter(async_entropy_converter & owner, result_type outMin, result_type target) :
+				owner(owner), outMin(outMin), target(target), result(0) { }
+
+			bool await_ready() { return poll(); }
+
+			void await_suspend(std::coroutine_handle<> h)
+			{
+				caller = h;
+				wait();
+			}
+
+			result_type await_resume() const { return outMin + result; }
+
+		private:
+			// Returns true if the conversion is done, or false if it needs more input.
+			bool poll()
+			{
+				switch (owner.c.try_convert(target, result, owner.source))
+				{
+				case convert_status::ok:
+					return true;
+				case convert_status::would_block:
+					return false;
+				case convert_status::invalid_output_range:
+					Converter::error_policy::raise("Output range is invalid");
+				case convert_status::output_range_too_large:
+					Converter::error_policy::raise("The output range is too large");
+				default:
+					Converter::error_policy::raise("Invalid input range");
+				}
+			}
+
+			// Resumes the caller once the conversion is done.
+			void wait()
+			{
+				owner.source.when_ready([this]()
+				{
+					if (poll())
+						caller.resume();
+					else
+						wait();
+				});
+			}
+
+			async_entropy_converter & owner;
+			result_type outMin, target, result;
+			std::coroutine_handle<> caller;
+		};
+
+		// Returns an awaitable uniform random integer in the range [outMin, outMax].
+		awaiter convert_async(result_type outMin, result_type outMax)
+		{
+			if (outMin > outMax)
+				Converter::error_policy::raise("Invalid output range");
+			return awaiter(*this, outMin, 1 + outMax - outMin);
+		}
+
+		// Returns an awaitable uniform random integer in the range [0,target).
+		awaiter convert_async(result_type target)
+		{
+			if (target <= 0)
+				Converter::error_policy::raise("Output range is invalid");
+			return awaiter(*this, 0, target);
+		}
+
+		// The converter, which also holds the buffered entropy.
+		Converter & converter() { return c; }
+
+	private:
+		Source & source;
+		Converter c;
+	};
+}
+#endif
@@ -0,0 +1,356 @@
+// Exact sampling from weighted discrete distributions using entropy_converter.
+// Weights are integers, so each outcome has exactly the requested probability.
+//
+// Example:
+//
+// entropy_converter<std::uint64_t> c;
+// std::random_device d;
+// econv::discrete_sampler loot = { 90, 9, 1 };
+// std::cout << "You found item " << loot(c, d) << std::endl;
+//
+// econv::dynamic_discrete_sampler players = { 5, 3, 8 };
+// auto p = players(c, d);
+// players.set_weight(p, 0);  // Remove player p
+
+#pragma once
+
+#include "entropy_converter.hpp"
+#include <cstdint>
+#include <initializer_list>
+#include <limits>
+#include <vector>
+
+namespace econv
+{
+	namespace detail
+	{
+		// Converts x to the result_type of a converter.
+		// Raises an error using the converter's error policy if x does not fit, rather than truncating it.
+		template<typename Converter>
+		typename Converter::result_type to_result(std::uint64_t x)
+		{
+			if (x > std::numeric_limits<typename Converter::result_type>::max())
+				Converter::error_policy::raise("Parameter is too large for the converter");
+			return (typename Converter::result_type)x;
+		}
+	}
+
+	// The algorithm used by discrete_sampler.
+	enum class discrete_method
+	{
+		// Walker's alias method. Reads log2(n) + log2(w) bits per sample, where
+		// n is the number of weights and w is the total weight.
+		alias,
+
+		// The Fast Loaded Dice Roller, based on Knuth and Yao's DDG trees.
+		// Reads fewer than H + 6 bits per sample, where H is the entropy of the distribution.
+		loaded_dice
+	};
+
+	// Samples integers in [0,n) with probability proportional to integer weights.
+	// Invalid weights are reported using ErrorPolicy.
+	template<typename ErrorPolicy = default_error_policy>
+	class basic_discrete_sampler
+	{
+	public:
+		typedef std::size_t result_type;
+		typedef std::uint64_t weight_type;
+
+		template<typename InputIt>
+		basic_discrete_sampler(InputIt first, InputIt last, discrete_method method = discrete_method::alias) :
+			weights(first, last), method(method)
+		{
+			init();
+		}
+
+		basic_discrete_sampler(std::initializer_list<weight_type> w, discrete_method method = discrete_method::alias) :
+			weights(w), method(method)
+		{
+			init();
+		}
+
+		// Returns a random integer in [0, size()), where i has probability weight(i)/total_weight().
+		// c is an entropy_converter, and gen is a uniform random number generator like std::random_device.
+		// For the alias method, raises an error using c's error policy if size() or total_weight() does not fit in its result_type.
+		template<typename Converter, typename Generator>
+		result_type operator()(Converter &c, Generator &gen) const
+		{
+			if (method == discrete_method::alias)
+			{
+				auto n = detail::to_result<Converter>(weights.size());
+				auto t = detail::to_result<Converter>(total);
+				auto column = (result_type)c.convert(n, gen);
+				if (threshold[column] == total)
+					return column;
+				return c.convert(t, gen) < threshold[column] ? column : alias[column];
+			}
+			else
+			{
+				if (total == 1)
+					return leaves[0];
+
+				// Walk the DDG tree one bit at a time.
+				result_type d = 0, level = 0;
+				for (;;)
+				{
+					d = 2 * d + (result_type)c.convert(2, gen);
+					if (d < level_counts[level + 1] - level_counts[level])
+					{
+						auto i = leaves[level_counts[level] + d];
+						if (i < weights.size())
+							return i;
+						d = level = 0;
+					}
+					else
+					{
+						d -= level_counts[level + 1] - level_counts[level];
+						++level;
+					}
+				}
+			}
+		}
+
+		std::size_t size() const { return weights.size(); }
+
+		// The weights, divided by their greatest common divisor.
+		weight_type weight(std::size_t i) const { return weights[i]; }
+
+		// The sum of weight(i).
+		weight_type total_weight() const { return total; }
+
+	private:
+		void init()
+		{
+			weight_type g = 0;
+			for (auto w : weights)
+				g = gcd(g, w);
+			if (g == 0)
+				ErrorPolicy::raise("Weights must not all be zero");
+
+			total = 0;
+			for (auto &w : weights)
+			{
+				w /= g;
+				if (w > ~weight_type(0) - total)
+					ErrorPolicy::raise("Total weight is too large");
+				total += w;
+			}
+
+			if (method == discrete_method::alias)
+				init_alias();
+			else
+				init_loaded_dice();
+		}
+
+		// Vose's algorithm, in integers.
+		// Each column has capacity 'total', and weight i is scaled to n*w(i).
+		void init_alias()
+		{
+			auto n = weights.size();
+			if (total > ~weight_type(0) / n)
+				ErrorPolicy::raise("Total weight is too large");
+
+			std::vector<weight_type> scaled(n);
+			std::vector<result_type> small, large;
+			threshold.resize(n);
+			alias.resize(n);
+			for (std::size_t i = 0; i < n; ++i)
+			{
+				scaled[i] = weights[i] * n;
+				(scaled[i] < total ? small : large).push_back(i);
+			}
+
+			while (!small.empty() && !large.empty())
+			{
+				auto s = small.back(), l = large.back();
+				small.pop_back();
+				threshold[s] = scaled[s];
+				alias[s] = l;
+				scaled[l] -= total - scaled[s];
+				if (scaled[l] < total)
+				{
+					large.pop_back();
+					small.push_back(l);
+				}
+			}
+
+			for (auto i : small)
+				threshold[i] = total, alias[i] = i;
+			for (auto i : large)
+				threshold[i] = total, alias[i] = i;
+		}
+
+		// Builds the DDG tree of the Fast Loaded Dice Roller.
+		// An extra outcome with weight 2^k - total pads the total weight to a power of 2,
+		// and restarts sampling if it is chosen.
+		void init_loaded_dice()
+		{
+			int k = 0;
+			while (k < 64 && (weight_type(1) << k) < total)
+				++k;
+			if (k == 64)
+				ErrorPolicy::raise("Total weight is too large");
+
+			auto padded = weights;
+			padded.push_back((weight_type(1) << k) - total);
+
+			// Level j of the tree has a leaf for each weight with bit k-1-j set.
+			level_counts.assign(1, 0);
+			for (int j = 0; j < k; ++j)
+			{
+				for (std::size_t i = 0; i < padded.size(); ++i)
+					if ((padded[i] >> (k - 1 - j)) & 1)
+						leaves.push_back(i);
+				level_counts.push_back(leaves.size());
+			}
+			if (k == 0)
+			{
+				// A single outcome, which needs no entropy.
+				for (std::size_t i = 0; i < weights.size(); ++i)
+					if (weights[i])
+						leaves.push_back(i);
+			}
+		}
+
+		static weight_type gcd(weight_type a, weight_type b)
+		{
+			while (b)
+			{
+				auto t = a % b;
+				a = b;
+				b = t;
+			}
+			return a;
+		}
+
+		std::vector<weight_type> weights;
+		discrete_method method;
+		weight_type total;
+
+		// The alias table.
+		std::vector<weight_type> threshold;
+		std::vector<result_type> alias;
+
+		// The DDG tree, where leaves[level_counts[j]...level_counts[j+1]) are the leaves at level j.
+		std::vector<result_type> leaves, level_counts;
+	};
+
+	typedef basic_discrete_sampler<> discrete_sampler;
+
+	// Samples integers in [0,n) with probability proportional to integer weights,
+	// where the weights can change between samples. Invalid weights are reported using ErrorPolicy.
+	//
+	// The weights are stored in a Fenwick tree, which is an implicit tree in a flat array.
+	// Sampling and changing a weight both take O(log n) time.
+	template<typename ErrorPolicy = default_error_policy>
+	class basic_dynamic_discrete_sampler
+	{
+	public:
+		typedef std::size_t result_type;
+		typedef std::uint64_t weight_type;
+
+		basic_dynamic_discrete_sampler() : tree(1), total(0)
+		{
+		}
+
+		template<typename InputIt>
+		basic_dynamic_discrete_sampler(InputIt first, InputIt last) : weights(first, last)
+		{
+			init();
+		}
+
+		basic_dynamic_discrete_sampler(std::initializer_list<weight_type> w) : weights(w)
+		{
+			init();
+		}
+
+		// Returns a random integer in [0, size()), where i has probability weight(i)/total_weight().
+		// c is an entropy_converter, and gen is a uniform random number generator like std::random_device.
+		// Raises an error if the total weight is zero, or using c's error policy if it does not fit in c's result_type.
+		template<typename Converter, typename Generator>
+		result_type operator()(Converter &c, Generator &gen) const
+		{
+			if (total == 0)
+				ErrorPolicy::raise("Weights must not all be zero");
+			weight_type r = c.convert(detail::to_result<Converter>(total), gen);
+
+			// Find the first i where the sum of weights [0,i] exceeds r.
+			std::size_t pos = 0;
+			for (std::size_t step = top; step; step >>= 1)
+			{
+				if (pos + step < tree.size() && tree[pos + step] <= r)
+				{
+					pos += step;
+					r -= tree[pos];
+				}
+			}
+			return pos;
+		}
+
+		// Changes the weight of i.
+		void set_weight(std::size_t i, weight_type w)
+		{
+			if (w > weights[i] && w - weights[i] > ~weight_type(0) - total)
+				ErrorPolicy::raise("Total weight is too large");
+			weight_type delta = w - weights[i];  // Wraps around if the weight decreases
+			weights[i] = w;
+			total += delta;
+			for (++i; i < tree.size(); i += i & (0 - i))
+				tree[i] += delta;
+		}
+
+		// Adds an outcome with weight w.
+		void push_back(weight_type w)
+		{
+			if (w > ~weight_type(0) - total)
+				ErrorPolicy::raise("Total weight is too large");
+			auto i = tree.size();
+			weight_type sum = w;
+			for (auto j = i - 1; j > i - (i & (0 - i)); j -= j & (0 - j))
+				sum += tree[j];
+			weights.push_back(w);
+			tree.push_back(sum);
+			total += w;
+			while (top * 2 < tree.size())
+				top *= 2;
+		}
+
+		std::size_t size() const { return weights.size(); }
+
+		weight_type weight(std::size_t i) const { return weights[i]; }
+
+		// The sum of weight(i).
+		weight_type total_weight() const { return total; }
+
+	private:
+		void init()
+		{
+			tree.assign(weights.size() + 1, 0);
+			total = 0;
+			top = 1;
+			for (std::size_t i = 1; i < tree.size(); ++i)
+			{
+				if (weights[i - 1] > ~weight_type(0) - total)
+					ErrorPolicy::raise("Total weight is too large");
+				total += weights[i - 1];
+				tree[i] += weights[i - 1];
+				auto parent = i + (i & (0 - i));
+				if (parent < tree.size())
+					tree[parent] += tree[i];
+				while (top * 2 < tree.size())
+					top *= 2;
+			}
+		}
+
+		std::vector<weight_type> weights;
+
+		// tree[i] is the sum of weights (i - lowbit(i), i], with tree[0] unused.
+		std::vector<weight_type> tree;
+		weight_type total;
+
+		// The largest power of 2 less than tree.size().
+		std::size_t top = 1;
+	};
+
+	typedef basic_dynamic_discrete_sampler<> dynamic_discrete_sampler;
+}
@@ -0,0 +1,413 @@
+// Exact samplers for parametric discrete distributions using entropy_converter.
+// Probabilities are rational numbers a/b, and all arithmetic is in integers,
+// so each outcome has exactly the right probability.
+// Invalid parameters are reported using the ErrorPolicy of each basic_ sampler,
+// and the typedefs without the prefix use default_error_policy.
+//
+// Example: how many of 5 cards dealt from a deck are hearts?
+//
+// entropy_converter<std::uint64_t> c;
+// std::random_device d;
+// econv::hypergeometric_sampler hearts(52, 13, 5);
+// std::cout << hearts(c, d) << " hearts\n";
+
+#pragma once
+
+#include "entropy_converter.hpp"
+#include "discrete_sampler.hpp"
+#include "sampling.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace econv
+{
+	namespace detail
+	{
+		// Unsigned integers of w 32-bit words, least significant word first.
+
+		inline void multiply(std::uint32_t *x, std::size_t w, std::uint32_t m)
+		{
+			std::uint64_t carry = 0;
+			for (std::size_t i = 0; i < w; ++i)
+			{
+				carry += (std::uint64_t)x[i] * m;
+				x[i] = (std::uint32_t)carry;
+				carry >>= 32;
+			}
+		}
+
+		// The division must be exact.
+		inline void divide(std::uint32_t *x, std::size_t w, std::uint32_t m)
+		{
+			std::uint64_t r = 0;
+			for (std::size_t i = w; i-- > 0;)
+			{
+				r = r << 32 | x[i];
+				x[i] = (std::uint32_t)(r / m);
+				r %= m;
+			}
+		}
+
+		inline void add(std::uint32_t *x, const std::uint32_t *y, std::size_t w)
+		{
+			std::uint64_t carry = 0;
+			for (std::size_t i = 0; i < w; ++i)
+			{
+				carry += (std::uint64_t)x[i] + y[i];
+				x[i] = (std::uint32_t)carry;
+				carry >>= 32;
+			}
+		}
+
+		inline int compare(const std::uint32_t *x, const std::uint32_t *y, std::size_t w)
+		{
+			for (std::size_t i = w; i-- > 0;)
+				if (x[i] != y[i])
+					return x[i] < y[i] ? -1 : 1;
+			return 0;
+		}
+
+		// Checks that a/b is a valid probability.
+		template<typename ErrorPolicy>
+		void check_probability(std::uint64_t a, std::uint64_t b)
+		{
+			if (b == 0 || a > b)
+				ErrorPolicy::raise("Invalid probability");
+		}
+	}
+
+	// Samples the number of failures before the first success,
+	// where each trial succeeds with probability a/b.
+	// Each trial reads close to its binary entropy, so sampling reads close to the entropy
+	// of the distribution, but it takes O(b/a) time.
+	template<typename ErrorPolicy = default_error_policy>
+	class basic_geometric_sampler
+	{
+	public:
+		typedef std::uint64_t result_type;
+
+		basic_geometric_sampler(std::uint64_t a, std::uint64_t b) : a(a), b(b)
+		{
+			detail::check_probability<ErrorPolicy>(a, b);
+			if (a == 0)
+				ErrorPolicy::raise("Probability must not be zero");
+		}
+
+		template<typename Converter, typename Generator>
+		result_type operator()(Converter &c, Generator &gen) const
+		{
+			auto ta = detail::to_result<Converter>(a), tb = detail::to_result<Converter>(b);
+			result_type k = 0;
+			while (!c.bernoulli(ta, tb, gen))
+				++k;
+			return k;
+		}
+
+	private:
+		std::uint64_t a, b;
+	};
+
+	typedef basic_geometric_sampler<> geometric_sampler;
+
+	// Samples the number of successes in n trials,
+	// where each trial succeeds with probability a/b.
+	//
+	// When b^n < 2^62, this inverts the probability table using the Fast Loaded Dice Roller.
+	// Otherwise, when b < 2^32, it inverts the cumulative probability table exactly, by reading
+	// a uniform integer in [0,b^n) one base-b digit at a time, until its digits so far determine the outcome.
+	// Both read close to the entropy of the result, for example about 8 bits for Binomial(1000, 1/10).
+	//
+	// The cumulative table holds n+1 integers of n log2(b) bits, so when it would not fit in 2^17 words,
+	// the trials are split into the largest blocks that fit, and the entropy is linear in the number of blocks.
+	// When b >= 2^32, each trial is sampled separately.
+	template<typename ErrorPolicy = default_error_policy>
+	class basic_binomial_sampler
+	{
+	public:
+		typedef std::uint64_t result_type;
+
+		basic_binomial_sampler(std::uint64_t n, std::uint64_t a, std::uint64_t b) :
+			n(n), block(1), full({ 1 }), rest({ 1 })
+		{
+			detail::check_probability<ErrorPolicy>(a, b);
+			if (a == 0 || a == b || n == 0)
+			{
+				trivial = a == b ? n : 0;
+				return;
+			}
+			auto g = a;
+			for (auto t = b; t;) { auto u = g % t; g = t; t = u; }
+			a /= g, b /= g;
+
+			// Find the largest block size where b^m fits.
+			const std::uint64_t max = std::uint64_t(1) << 62;
+			std::uint64_t power = b;
+			while (block < n && power <= max / b)
+				power *= b, ++block;
+
+			if (block < n && b <= 0xffffffff)
+			{
+				// Find the largest block size where the cumulative table fits.
+				while (block < n && cumulative_table::size(block + 1, b) <= max_words)
+					++block;
+				full_table = cumulative_table(block, a, b);
+				rest_table = cumulative_table(n % block, a, b);
+				return;
+			}
+			full = make_block(block, a, b);
+			rest = make_block(n % block, a, b);
+		}
+
+		template<typename Converter, typename Generator>
+		result_type operator()(Converter &c, Generator &gen) const
+		{
+			if (trivial != none)
+				return trivial;
+			result_type k = 0;
+			if (full_table.trials() > 0)
+			{
+				for (std::uint64_t i = 0; i < n / block; ++i)
+					k += full_table(c, gen);
+				if (n % block)
+					k += rest_table(c, gen);
+				return k;
+			}
+			for (std::uint64_t i = 0; i < n / block; ++i)
+				k += full(c, gen);
+			if (n % block)
+				k += rest(c, gen);
+			return k;
+		}
+
+	private:
+		// The probability table of m trials, where k successes has weight C(m,k) a^k (b-a)^(m-k).
+		static basic_discrete_sampler<ErrorPolicy> make_block(std::uint64_t m, std::uint64_t a, std::uint64_t b)
+		{
+			if (m == 0 || a == 0 || a == b)
+				return basic_discrete_sampler<ErrorPolicy>({ 1 });
+
+			std::vector<std::uint64_t> weights(m + 1);
+			for (std::uint64_t k = 0; k <= m; ++k)
+			{
+				auto w = detail::binomial_coefficient(m, k);
+				for (std::uint64_t i = 0; i < k; ++i) w *= a;
+				for (std::uint64_t i = k; i < m; ++i) w *= b - a;
+				weights[k] = w;
+			}
+			return basic_discrete_sampler<ErrorPolicy>(weights.begin(), weights.end(), discrete_method::loaded_dice);
+		}
+
+		// The cumulative probability table of m trials, where entry k is the sum of
+		// C(m,i) a^i (b-a)^(m-i) for i <= k, and entry m is b^m. b < 2^32.
+		class cumulative_table
+		{
+		public:
+			cumulative_table() { }
+
+			cumulative_table(std::uint64_t m, std::uint64_t a, std::uint64_t b) :
+				m(m), b(b), words(size(m, b) / (m + 1)), table(size(m, b))
+			{
+				// Two more words hold the products before each division.
+				std::vector<std::uint32_t> weight(words + 2);
+				weight[0] = 1;
+				for (std::uint64_t i = 0; i < m; ++i)
+					detail::multiply(weight.data(), words, (std::uint32_t)(b - a));
+				std::copy(weight.begin(), weight.begin() + words, table.begin());
+				for (std::uint64_t k = 1; k <= m; ++k)
+				{
+					// C(m,k) a^k (b-a)^(m-k) from C(m,k-1) a^(k-1) (b-a)^(m-k+1), where each division is exact.
+					detail::multiply(weight.data(), words + 2, (std::uint32_t)(m - k + 1));
+					detail::divide(weight.data(), words + 2, (std::uint32_t)k);
+					detail::multiply(weight.data(), words + 2, (std::uint32_t)a);
+					detail::divide(weight.data(), words + 2, (std::uint32_t)(b - a));
+					std::copy(table.begin() + (k - 1) * words, table.begin() + k * words, table.begin() + k * words);
+					detail::add(&table[k * words], weight.data(), words);
+				}
+			}
+
+			// The number of words in the table of m trials.
+			static std::uint64_t size(std::uint64_t m, std::uint64_t b)
+			{
+				int bits = 0;
+				while ((std::uint64_t(1) << bits) < b)
+					++bits;
+				return (m + 1) * ((m * bits + 32) / 32);
+			}
+
+			std::uint64_t trials() const { return m; }
+
+			// Reads a uniform integer x in [0,b^m) one digit at a time, keeping the range [lower, lower+width)
+			// that is consistent with the digits so far, and returns k where entry k-1 <= x < entry k
+			// as soon as the whole range is inside it.
+			template<typename Converter, typename Generator>
+			result_type operator()(Converter &c, Generator &gen) const
+			{
+				auto digit = detail::to_result<Converter>(b);
+				std::vector<std::uint32_t> lower(words), width(table.end() - words, table.end()), upper(words);
+				for (;;)
+				{
+					// The number of entries <= lower.
+					std::uint64_t k = 0, hi = m;
+					while (k < hi)
+					{
+						auto mid = k + (hi - k) / 2;
+						if (detail::compare(&table[mid * words], lower.data(), words) <= 0)
+							k = mid + 1;
+						else
+							hi = mid;
+					}
+					upper = lower;
+					detail::add(upper.data(), width.data(), words);
+					if (detail::compare(upper.data(), &table[k * words], words) <= 0)
+						return k;
+
+					detail::divide(width.data(), words, (std::uint32_t)b);
+					upper = width;
+					detail::multiply(upper.data(), words, (std::uint32_t)c.convert(digit, gen));
+					detail::add(lower.data(), upper.data(), words);
+				}
+			}
+
+		private:
+			std::uint64_t m = 0, b = 0;
+			std::size_t words = 0;
+			std::vector<std::uint32_t> table;
+		};
+
+		static const result_type none = ~result_type(0);
+		static const std::uint64_t max_words = 1 << 17;
+		std::uint64_t n, block;
+		basic_discrete_sampler<ErrorPolicy> full, rest;
+		cumulative_table full_table, rest_table;
+		result_type trivial = none;
+	};
+
+	typedef basic_binomial_sampler<> binomial_sampler;
+
+	// Samples from the Poisson distribution with mean a/b.
+	//
+	// Uses Duchon and Duvignau's exact Poisson(1) generator, which only needs uniform integers.
+	// The whole part of the mean is a sum of Poisson(1) samples, and the fractional part
+	// keeps each point of a Poisson(1) sample with probability (a%b)/b.
+	// Sampling takes O(a/b) calls to the Poisson(1) generator, so its time and entropy
+	// are linear in the mean, whereas the entropy of the result only grows with log(a/b).
+	// The probabilities are irrational, so there is no finite table to invert.
+	template<typename ErrorPolicy = default_error_policy>
+	class basic_poisson_sampler
+	{
+	public:
+		typedef std::uint64_t result_type;
+
+		basic_poisson_sampler(std::uint64_t a, std::uint64_t b) : a(a), b(b)
+		{
+			if (b == 0)
+				ErrorPolicy::raise("Invalid mean");
+		}
+
+		template<typename Converter, typename Generator>
+		result_type operator()(Converter &c, Generator &gen) const
+		{
+			result_type k = 0;
+			for (std::uint64_t i = 0; i < a / b; ++i)
+				k += poisson1(c, gen);
+			if (a % b)
+			{
+				auto ta = detail::to_result<Converter>(a % b), tb = detail::to_result<Converter>(b);
+				for (auto points = poisson1(c, gen); points > 0; --points)
+					k += c.bernoulli(ta, tb, gen);
+			}
+			return k;
+		}
+
+	private:
+		// Samples Poisson(1) by growing a uniform random permutation,
+		// and stopping at a random size where the number of fixed points is exactly Poisson(1).
+		template<typename Converter, typename Generator>
+		static result_type poisson1(Converter &c, Generator &gen)
+		{
+			typedef typename Converter::result_type T;
+			T n = 1, g = 0;
+			result_type k = 1;
+			for (;; ++n)
+			{
+				T i = 1 + c.convert(n + 1, gen);
+				if (i == n + 1)
+					++k;
+				else if (i > g)
+				{
+					--k;
+					g = n + 1;
+				}
+				else
+					return k;
+			}
+		}
+
+		std::uint64_t a, b;
+	};
+
+	typedef basic_poisson_sampler<> poisson_sampler;
+
+	// Samples the number of successes when drawing n items without replacement
+	// from a population of N items, K of which are successes.
+	//
+	// When C(N,n) < 2^62, this samples by exact inversion of the probability table
+	// using the Fast Loaded Dice Roller, in O(n) memory and close to optimal entropy.
+	// Otherwise, it draws min(n, N-n) items one at a time using bernoulli(), in O(n) time.
+	template<typename ErrorPolicy = default_error_policy>
+	class basic_hypergeometric_sampler
+	{
+	public:
+		typedef std::uint64_t result_type;
+
+		basic_hypergeometric_sampler(std::uint64_t N, std::uint64_t K, std::uint64_t n) :
+			N(N), K(K), n(n), table({ 1 })
+		{
+			if (K > N || n > N)
+				ErrorPolicy::raise("Invalid hypergeometric parameters");
+
+			auto min = n > N - K ? n - (N - K) : 0, max = n < K ? n : K;
+			if (min == max)
+			{
+				offset = min;
+				return;
+			}
+			if (detail::binomial_coefficient(N, n) != 0)
+			{
+				// x successes has weight C(K,x) C(N-K,n-x), which sum to C(N,n).
+				std::vector<std::uint64_t> weights(max - min + 1);
+				for (auto x = min; x <= max; ++x)
+					weights[x - min] = detail::binomial_coefficient(K, x) * detail::binomial_coefficient(N - K, n - x);
+				table = basic_discrete_sampler<ErrorPolicy>(weights.begin(), weights.end(), discrete_method::loaded_dice);
+				offset = min;
+			}
+			else
+				sequential = true;
+		}
+
+		template<typename Converter, typename Generator>
+		result_type operator()(Converter &c, Generator &gen) const
+		{
+			if (!sequential)
+				return offset + table(c, gen);
+
+			// Successes among the drawn items, or among the items not drawn.
+			bool complement = n > N - n;
+			auto draws = complement ? N - n : n;
+			result_type x = 0;
+			for (std::uint64_t i = 0; i < draws; ++i)
+				x += c.bernoulli(detail::to_result<Converter>(K - x), detail::to_result<Converter>(N - i), gen);
+			return complement ? K - x : x;
+		}
+
+	private:
+		std::uint64_t N, K, n;
+		basic_discrete_sampler<ErrorPolicy> table;
+		result_type offset = 0;
+		bool sequential = false;
+	};
+
+	typedef basic_hypergeometric_sampler<> hypergeometric_sampler;
+}
@@ -16,14 +16,121 @@
 
 #pragma once
 
+#include <algorithm>
+#include <bitset>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <initializer_list>
 #include <limits>
+#include <random>
 #include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#if !defined(ECONV_EXCEPTIONS)
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS) || defined(_CPPUNWIND)
+#define ECONV_EXCEPTIONS 1
+#else
+#define ECONV_EXCEPTIONS 0
+#endif
+#endif
+
+// Error policies, which say what entropy_converter does when it is given an invalid argument,
+// or when a generator returns a value outside of its range.
+
+#if ECONV_EXCEPTIONS
+// Throws std::range_error. This is the default.
+struct throw_on_error
+{
+	[[noreturn]] static void raise(const char * message) { throw std::range_error(message); }
+};
+#endif
+
+// Calls std::abort(). This is the default when exceptions are disabled.
+struct abort_on_error
+{
+	[[noreturn]] static void raise(const char *) { std::abort(); }
+};
+
+// Errors are undefined behaviour. The optimizer can remove the checks.
+struct assume_no_error
+{
+	[[noreturn]] static void raise(const char *)
+	{
+#if defined(_MSC_VER)
+		__assume(0);
+#else
+		__builtin_unreachable();
+#endif
+	}
+};
+
+#if ECONV_EXCEPTIONS
+typedef throw_on_error default_error_policy;
+#else
+typedef abort_on_error default_error_policy;
+#endif
+
+// Refill policies, which say how much entropy entropy_converter buffers before a conversion.
+
+// Reads as much entropy as possible up-front. This is the default, and gives the best conversion efficiency.
+struct eager_refill
+{
+	template<typename T>
+	static constexpr T threshold(T, T max_threshold) { return max_threshold; }
+};
+
+// Reads only enough entropy that a conversion to target is rejected with probability less than 2^-Bits.
+// This reads fewer inputs before the first outputs of a new converter, at the cost of more rejections.
+template<int Bits>
+struct lazy_refill
+{
+	static_assert(Bits > 0 && Bits < 16, "Bits must be in the range [1,15]");
+
+	template<typename T>
+	static constexpr T threshold(T target, T max_threshold)
+	{
+		return target > (max_threshold >> Bits) ? max_threshold : T(target << Bits);
+	}
+};
+
+// The result of entropy_converter::try_convert.
+enum class convert_status
+{
+	ok,
+	invalid_output_range,
+	output_range_too_large,
+	invalid_input_range,
+	would_block
+};
+
+// Whether the outputs of Generator can be trusted to be in the range [gen.min(),gen.max()].
+// The outputs of trusted generators are not checked, which removes a branch for each
+// output of the generator. The standard random number engines are trusted.
+// Specialize this to trust other generators, for example
+//
+// template<> struct is_trusted_generator<my_generator> : std::true_type {};
+template<typename Generator>
+struct is_trusted_generator : std::false_type {};
+
+template<typename UIntType, UIntType a, UIntType c, UIntType m>
+struct is_trusted_generator<std::linear_congruential_engine<UIntType, a, c, m>> : std::true_type {};
+
+template<typename UIntType, std::size_t w, std::size_t n, std::size_t m, std::size_t r, UIntType a, std::size_t u, UIntType d, std::size_t s, UIntType b, std::size_t t, UIntType c, std::size_t l, UIntType f>
+struct is_trusted_generator<std::mersenne_twister_engine<UIntType, w, n, m, r, a, u, d, s, b, t, c, l, f>> : std::true_type {};
+
+template<typename UIntType, std::size_t w, std::size_t s, std::size_t r>
+struct is_trusted_generator<std::subtract_with_carry_engine<UIntType, w, s, r>> : std::true_type {};
 
 // The entopy converter.
 // It converts entropy, and buffers a limited amount of entropy.
 //
 // T is the type used to store output entropy, and 
 // Buffer is the type used to buffer the input (base-2) entropy.
+// ErrorPolicy is throw_on_error, abort_on_error or assume_no_error.
+// Limit is the maximum range of the buffered entropy, which defaults to the size of T.
+// RefillPolicy is eager_refill or lazy_refill<Bits>.
 //
 // Buffer should be at least as large as the data type of the generator,
 // usually "unsigned" for std::random_device.
@@ -32,12 +139,15 @@
 //
 // The 'convert' functions read entropy from one uniform distribution
 // and convert it into a uniform distribution of a different size.
-template<typename T=unsigned, typename Buffer=unsigned>
+template<typename T=unsigned, typename Buffer=unsigned, typename ErrorPolicy=default_error_policy, T Limit=std::numeric_limits<T>::max(), typename RefillPolicy=eager_refill>
 class entropy_converter
 {
+	static_assert(Limit >= 4, "Limit is too small");
 public:
 	typedef Buffer buffer_type;
 	typedef T result_type;
+	typedef ErrorPolicy error_policy;
+	typedef RefillPolicy refill_policy;
 
 	// Initialize the converter with zero entropy
 	entropy_converter() : value(0), range(1), buffer(0), buffer_max(0)
@@ -83,7 +193,7 @@ public:
 	result_type convert(result_type target, Generator & gen)
 	{
 		if (target <= 0)
-			throw std::range_error("Output range is invalid");
+			ErrorPolicy::raise("Output range is invalid");
 		return convert<result_type>(0, target - 1, gen);
 	}
 
@@ -94,7 +204,15 @@ public:
 	template<typename Result, typename Generator>
 	Result convert(Result outMin, Result outMax, Generator & gen)
 	{
-		return convert(outMin, outMax, gen.min(), gen.max(), gen);
+		if (outMin == outMax) return outMax;
+		if (outMin > outMax)
+			ErrorPolicy::raise("Invalid output range");
+
+		auto target = 1 + outMax - outMin;
+		return outMin + (Result)with_source(gen, [&](result_type src_range, auto source)
+		{
+			return convert_from_source(target, src_range, Limit / src_range, source);
+		});
 	}
 
 	// Reads entropy from gen and returns a uniform random integer.
@@ -104,52 +222,255 @@ public:
 	// Generator is a uniform random number generator like std::random_device.
 	// Return value is in the range [outMin, outMax]
 	template<typename Result, typename Input, typename Generator>
-	Result convert(Result outMin, Result outMax, Input inMin, Input inMax, Generator & gen, result_type limit = std::numeric_limits<result_type>::max())
+	Result convert(Result outMin, Result outMax, Input inMin, Input inMax, Generator & gen, result_type limit = Limit)
 	{
 		if (outMin == outMax) return outMax;
 		if (outMin > outMax)
-			throw std::range_error("Invalid output range");
-		if (inMin >= inMax)
-			throw std::range_error("Invalid input range");
+			ErrorPolicy::raise("Invalid output range");
 
 		auto target = 1 + outMax - outMin;
-		auto inRange = inMax - inMin;
-		if ((inRange & (inRange + 1)) == 0)
+		return outMin + (Result)with_source(inMin, inMax, gen, [&](result_type src_range, auto source)
 		{
-			// The generator produces powers of 2. In this case, we
-			// buffer the output of gen in 'buffer'.
+			return convert_from_source(target, src_range, limit / src_range, source);
+		});
+	}
+
+	// Reads entropy from gen and sets result to a uniform random integer in the range [0,target)
+	// Returns a status instead of reporting invalid ranges using the ErrorPolicy,
+	// in which case the converter is unchanged and no entropy is read.
+	//
+	// If gen has a member function bool try_generate(result_type & x), which returns false
+	// instead of blocking when no input is available, then try_convert does not block.
+	// It returns convert_status::would_block if there is not enough buffered entropy and gen
+	// has no input, in which case result is unchanged and no entropy is lost.
+	// Buffered entropy is used when the chance of rejecting it is less than 2^-8.
+	template<typename Generator>
+	convert_status try_convert(result_type target, result_type & result, Generator & gen)
+	{
+		if (target <= 0)
+			return convert_status::invalid_output_range;
+		if (input_range_error(gen.min(), gen.max()))
+			return convert_status::invalid_input_range;
+		return try_convert(target, result, gen, is_nonblocking<Generator>());
+	}
 
-			if (inRange > (Input)std::numeric_limits<buffer_type>::max())
-				throw std::range_error("buffer_size too small");
+private:
+	template<typename Generator>
+	convert_status try_convert(result_type target, result_type & result, Generator & gen, std::false_type)
+	{
+		return try_convert_from(target, result, gen);
+	}
 
-			return outMin + (Result)convert_from_source(target, 2, limit, [=,&gen]()
-			{
-				if (buffer_max == 0)
-				{
-					auto g = gen();
-					if (g < inMin)
-						throw std::range_error("Input value too small");
-					if (g > inMax)
-						throw std::range_error("Input value too large");
-					buffer = (buffer_type)(g - inMin);
-					buffer_max = (buffer_type)inRange;
-				}
-				auto r = buffer & 1;
-				buffer >>= 1;
-				buffer_max >>= 1;
-				return r;
-			});
+	template<typename Generator>
+	convert_status try_convert(result_type target, result_type & result, Generator & gen, std::true_type)
+	{
+		nonblocking_generator<Generator> nonblocking{ gen };
+		return try_convert_from(target, result, nonblocking);
+	}
+
+	template<typename Generator>
+	convert_status try_convert_from(result_type target, result_type & result, Generator & gen)
+	{
+		return with_source(gen, [&](result_type src_range, auto source)
+		{
+			const result_type threshold = Limit / src_range;
+			if (target > threshold)
+				return convert_status::output_range_too_large;
+			const result_type r = convert_from_source(target, src_range, threshold, source);
+			if (r == target)
+				return convert_status::would_block;
+			result = r;
+			return convert_status::ok;
+		});
+	}
+
+public:
+
+	// Reads entropy from gen and writes a uniform random integer in the range [0,t) to out,
+	// for each target t in [first,last).
+	// Consecutive targets are combined into a single call to convert their product,
+	// which is then split into mixed-radix digits, so there are fewer rejection tests.
+	template<typename ForwardIt, typename OutputIt, typename Generator>
+	OutputIt convert_many(ForwardIt first, ForwardIt last, OutputIt out, Generator & gen)
+	{
+		return with_source(gen, [&](result_type src_range, auto source)
+		{
+			return digits_from_source(first, last, out, src_range, Limit / src_range, source);
+		});
+	}
+
+	// Reads entropy from gen and writes a uniform random integer in the range [0,t) to out,
+	// for each target t in targets, for example convert_many({6, 6, 6, 20}, rolls, gen).
+	template<typename OutputIt, typename Generator>
+	OutputIt convert_many(std::initializer_list<result_type> targets, OutputIt out, Generator & gen)
+	{
+		return convert_many(targets.begin(), targets.end(), out, gen);
+	}
+
+	// Reads entropy from gen and writes n uniform random integers in the range [0,target) to out.
+	// Each call to convert reads k outputs at once as a uniform random integer in [0,target^k),
+	// which is split into base-target digits.
+	template<typename OutputIt, typename Generator>
+	OutputIt convert_n(result_type target, OutputIt out, std::size_t n, Generator & gen)
+	{
+		if (target <= 0)
+			ErrorPolicy::raise("Output range is invalid");
+		if (target == 1)
+			return std::fill_n(out, n, result_type(0));
+		return with_source(gen, [&](result_type src_range, auto source)
+		{
+			return digits_n_from_source(target, out, n, src_range, Limit / src_range, source);
+		});
+	}
+
+	// Reads entropy from gen and returns true with probability a/b.
+	// gen is a functor that returns a number in the range [gen.min(),gen.max()]
+	// Generator is a uniform random number generator like std::random_device.
+	// On average, this reads only slightly more than the binary entropy of a/b.
+	template<typename Generator>
+	bool bernoulli(result_type a, result_type b, Generator & gen)
+	{
+		if (b <= 0 || a > b)
+			ErrorPolicy::raise("Invalid probability");
+		if (a == 0) return false;
+		if (a == b) return true;
+		return with_source(gen, [&](result_type src_range, auto source)
+		{
+			return bernoulli_from_source(a, b, src_range, Limit / src_range, source);
+		});
+	}
+
+	// Writes n booleans to out, each of which is true with probability a/b.
+	template<typename OutputIt, typename Generator>
+	OutputIt bernoulli_n(result_type a, result_type b, OutputIt out, std::size_t n, Generator & gen)
+	{
+		if (b <= 0 || a > b)
+			ErrorPolicy::raise("Invalid probability");
+		if (a == 0 || a == b)
+			return std::fill_n(out, n, a == b);
+		return with_source(gen, [&](result_type src_range, auto source)
+		{
+			const result_type threshold = Limit / src_range;
+			for (std::size_t i = 0; i < n; ++i)
+				*out++ = bernoulli_from_source(a, b, src_range, threshold, source);
+			return out;
+		});
+	}
+
+	// Sets each bit in bits with probability a/b.
+	template<std::size_t N, typename Generator>
+	void bernoulli_n(result_type a, result_type b, std::bitset<N> & bits, Generator & gen)
+	{
+		if (b <= 0 || a > b)
+			ErrorPolicy::raise("Invalid probability");
+		if (a == 0 || a == b)
+		{
+			a == b ? bits.set() : bits.reset();
+			return;
 		}
-		else
+		with_source(gen, [&](result_type src_range, auto source)
+		{
+			const result_type threshold = Limit / src_range;
+			for (std::size_t i = 0; i < N; ++i)
+				bits[i] = bernoulli_from_source(a, b, src_range, threshold, source);
+			return 0;
+		});
+	}
+
+	// Reads entropy from gen and returns a uniform random real number in the range [a,b)
+	// The result is a+(b-a)*u, where u is a multiple of 2^-D in [0,1),
+	// D is the number of bits in the mantissa of Real, and u reads exactly D bits of entropy.
+	template<typename Real, typename Generator>
+	Real uniform_real(Real a, Real b, Generator & gen)
+	{
+		if (!(a < b))
+			ErrorPolicy::raise("Invalid output range");
+		return with_source(gen, [&](result_type src_range, auto source)
+		{
+			return real_from_source(a, b, src_range, Limit / src_range, source);
+		});
+	}
+
+	// Writes n uniform random real numbers in the range [a,b) to out.
+	template<typename OutputIt, typename Real, typename Generator>
+	OutputIt uniform_real_n(Real a, Real b, OutputIt out, std::size_t n, Generator & gen)
+	{
+		if (!(a < b))
+			ErrorPolicy::raise("Invalid output range");
+		return with_source(gen, [&](result_type src_range, auto source)
+		{
+			const result_type threshold = Limit / src_range;
+			for (std::size_t i = 0; i < n; ++i)
+				*out++ = real_from_source(a, b, src_range, threshold, source);
+			return out;
+		});
+	}
+
+	// Reads entropy from gen and returns a uniform random real number in the range [0,1)
+	// Every representable number x is returned with the probability that a uniform
+	// real number rounds down to x, including the small numbers near 0 that
+	// uniform_real() cannot return. This reads D bits of entropy, plus one bit for
+	// each leading zero of the result, so on average D+1 bits.
+	template<typename Real = double, typename Generator>
+	Real uniform_real_precise(Generator & gen)
+	{
+		return with_source(gen, [&](result_type src_range, auto source)
 		{
-			if (inRange >= std::numeric_limits<result_type>::max())
-				throw std::range_error("buffer_size too small");
+			const int D = std::numeric_limits<Real>::digits;
+			const result_type threshold = Limit / src_range;
 
-			return outMin + (Result)convert_from_source(target, (result_type)(inRange + 1), limit, [=,&gen]()
+			// Skip blocks of D zero bits.
+			int exponent = -D;
+			std::uint64_t m;
+			while ((m = bits_from_source(D, src_range, threshold, source)) == 0)
 			{
-				return gen() - inMin;
-			});
+				exponent -= D;
+				if (exponent < std::numeric_limits<Real>::min_exponent - 2 * D)
+					return Real(0);  // Underflow
+			}
+
+			// Shift the leading 1 to the top of the mantissa, and read the bits below.
+			int zeros = 0;
+			while (!(m >> (D - 1 - zeros)))
+				++zeros;
+			if (zeros)
+				m = (m << zeros) | bits_from_source(zeros, src_range, threshold, source);
+			return std::ldexp(Real(m), exponent - zeros);
+		});
+	}
+
+	// Returns a uniform random integer in [0,target) using only the entropy that is
+	// already buffered, without reading from a generator.
+	// Returns false if there is not enough buffered entropy, in which case the
+	// remaining entropy is kept for the next call.
+	bool convert_buffered(result_type target, result_type & result)
+	{
+		if (target <= 0)
+			ErrorPolicy::raise("Output range is invalid");
+
+		// Move any buffered bits into "value".
+		while (buffer_max > 0 && range <= Limit / 2)
+		{
+			value = value * 2 + (buffer & 1);
+			range *= 2;
+			buffer >>= 1;
+			buffer_max >>= 1;
 		}
+
+		if (range < target)
+			return false;
+
+		result_type new_range = range - range % target;
+		if (value < new_range)
+		{
+			result = value % target;
+			value /= target;
+			range = new_range / target;
+			return true;
+		}
+		value -= new_range;
+		range -= new_range;
+		return false;
 	}
 
 	// Return a functor generating that generates
@@ -180,30 +501,469 @@ public:
 		return (long double)range * (long double)buffer_max + (long double)range;
 	}
 
+	// Returns the number of whole bits of buffered entropy, which is floor(log2(get_buffered_range())).
+	int available_bits() const
+	{
+		return bit_width(range) - 1 + bit_width(buffer_max);
+	}
+
+	// Reads entropy from gen until the converter buffers as much entropy as it can,
+	// so that the following conversions read as little as possible from gen.
+	// This moves reads from a slow generator out of latency-critical code.
+	template<typename Generator>
+	void reserve(Generator & gen)
+	{
+		with_source(gen, [&](result_type src_range, auto source)
+		{
+			fill(src_range, Limit / src_range, source);
+			load_buffer(source);
+			return 0;
+		});
+	}
+
+	// Reads entropy from gen until available_bits() is at least bits, or the converter is full.
+	template<typename Generator>
+	void prefill(Generator & gen, int bits)
+	{
+		if (available_bits() >= bits)
+			return;
+		with_source(gen, [&](result_type src_range, auto source)
+		{
+			const result_type threshold = Limit / src_range;
+			while (available_bits() < bits)
+			{
+				if (range < threshold)
+				{
+					// A binary source moves bits from "buffer" into "value", so recount them each time.
+					const int needed = bits - bit_width(buffer_max);
+					fill(src_range, needed < bit_width(threshold) ? (result_type)1 << needed : threshold, source);
+				}
+				else if (!load_buffer(source))
+				{
+					// "value" is full, and "buffer" is in use or there is no buffer.
+					break;
+				}
+			}
+			return 0;
+		});
+	}
+
 private:
+	// The input range of a generator, known at runtime.
+	template<typename Input>
+	struct runtime_range
+	{
+		typedef Input input_type;
+		Input inMin, inMax;
+		Input min() const { return inMin; }
+		Input max() const { return inMax; }
+	};
+
+	// The input range of a generator, known at compile time.
+	template<typename Input, Input Min, Input Max>
+	struct constant_range
+	{
+		typedef Input input_type;
+		static constexpr Input min() { return Min; }
+		static constexpr Input max() { return Max; }
+	};
+
+	template<typename... Ts>
+	struct make_void { typedef void type; };
+
+	// Whether Generator::min() and Generator::max() are constant expressions,
+	// as they are for std::random_device and the standard engines.
+	template<typename Generator, typename = void>
+	struct has_constant_range : std::false_type {};
+
+	template<typename Generator>
+	struct has_constant_range<Generator, typename make_void<
+		std::integral_constant<decltype(Generator::min()), Generator::min()>,
+		std::integral_constant<decltype(Generator::max()), Generator::max()>>::type> : std::true_type {};
+
+	// Whether Generator has a member function bool try_generate(result_type & x) that does not block.
+	template<typename Generator, typename = void>
+	struct is_nonblocking : std::false_type {};
+
+	template<typename Generator>
+	struct is_nonblocking<Generator, typename make_void<
+		decltype(std::declval<Generator &>().try_generate(std::declval<typename Generator::result_type &>()))>::type> : std::true_type {};
+
+	// A generator that is read using try_generate, so that sources read from it return false instead of blocking.
+	template<typename Generator>
+	struct nonblocking_generator
+	{
+		Generator & gen;
+		auto min() const { return gen.min(); }
+		auto max() const { return gen.max(); }
+	};
+
+	// Whether every output of Generator is in range, so the outputs do not need to be checked.
+	template<typename Generator>
+	struct is_trusted : is_trusted_generator<Generator> {};
+
+	template<typename Generator>
+	struct is_trusted<nonblocking_generator<Generator>> : is_trusted_generator<Generator> {};
+
+	// Sets x to the next output of gen, and returns false if gen would block.
+	template<typename Generator, typename Input>
+	static bool generate(Generator & gen, Input & x)
+	{
+		x = gen();
+		return true;
+	}
+
+	template<typename Generator, typename Input>
+	static bool generate(nonblocking_generator<Generator> & gen, Input & x)
+	{
+		typename Generator::result_type y;
+		if (!gen.gen.try_generate(y))
+			return false;
+		x = (Input)y;
+		return true;
+	}
+
+	// Calls fn(src_range, source), where source supplies
+	// uniform integers in the range [0,src_range), read from gen.
+	// gen is a functor that returns a number in the range [gen.min(),gen.max()]
+	template<typename Generator, typename Fn>
+	auto with_source(Generator & gen, Fn fn)
+	{
+		return with_source(gen, fn, has_constant_range<Generator>());
+	}
+
+	template<typename Generator, typename Fn>
+	auto with_source(Generator & gen, Fn fn, std::false_type)
+	{
+		return with_source(gen.min(), gen.max(), gen, fn);
+	}
+
+	// with_source for a generator whose range is known at compile time,
+	// so that the checks on the input range are made at compile time.
+	template<typename Generator, typename Fn>
+	auto with_source(Generator & gen, Fn fn, std::true_type)
+	{
+		typedef decltype(Generator::max()) Input;
+		const Input inMin = Generator::min(), inMax = Generator::max();
+		static_assert(inMin < inMax, "Invalid input range");
+		return with_constant_source<Input, inMin, inMax>(gen, fn, std::integral_constant<bool, ((inMax - inMin) & (inMax - inMin + 1)) == 0>());
+	}
+
+	// The generator produces powers of 2.
+	template<typename Input, Input inMin, Input inMax, typename Generator, typename Fn>
+	auto with_constant_source(Generator & gen, Fn fn, std::true_type)
+	{
+		static_assert(inMax - inMin <= (Input)std::numeric_limits<buffer_type>::max() || std::numeric_limits<buffer_type>::digits >= std::numeric_limits<Input>::digits,
+			"buffer_size too small");
+		return fn(2, binary_source<constant_range<Input, inMin, inMax>, Generator>{ *this, gen, {} });
+	}
+
+	template<typename Input, Input inMin, Input inMax, typename Generator, typename Fn>
+	auto with_constant_source(Generator & gen, Fn fn, std::false_type)
+	{
+		static_assert(inMax - inMin < std::numeric_limits<result_type>::max() || std::numeric_limits<result_type>::digits > std::numeric_limits<Input>::digits,
+			"buffer_size too small");
+		return fn((result_type)(inMax - inMin + 1), general_source<constant_range<Input, inMin, inMax>, Generator>{ gen, {} });
+	}
+
+	// Calls fn(src_range, source), where source supplies
+	// uniform integers in the range [0,src_range), read from gen.
+	// gen is a functor that returns a number in the range [inMin,inMax]
+	// Returns the reason why [inMin,inMax] cannot be used as an input range, or nullptr if it can.
+	template<typename Input>
+	static const char * input_range_error(Input inMin, Input inMax)
+	{
+		if (inMin >= inMax)
+			return "Invalid input range";
+		auto inRange = inMax - inMin;
+		if ((inRange & (inRange + 1)) == 0 ? inRange > (Input)std::numeric_limits<buffer_type>::max() : inRange >= std::numeric_limits<result_type>::max())
+			return "buffer_size too small";
+		return nullptr;
+	}
+
+	template<typename Input, typename Generator, typename Fn>
+	auto with_source(Input inMin, Input inMax, Generator & gen, Fn fn)
+	{
+		if (auto error = input_range_error(inMin, inMax))
+			ErrorPolicy::raise(error);
+
+		auto inRange = inMax - inMin;
+		if ((inRange & (inRange + 1)) == 0)
+		{
+			// The generator produces powers of 2. In this case, we
+			// buffer the output of gen in 'buffer'.
+			return fn(2, binary_source<runtime_range<Input>, Generator>{ *this, gen, { inMin, inMax } });
+		}
+		else
+		{
+			return fn((result_type)(inRange + 1), general_source<runtime_range<Input>, Generator>{ gen, { inMin, inMax } });
+		}
+	}
+
+	// A source of integers in [0,gen.max()-gen.min()], read directly from gen.
+	// Range is runtime_range or constant_range.
+	template<typename Range, typename Generator>
+	struct general_source
+	{
+		Generator & gen;
+		Range in;
+
+		static constexpr bool checked = !is_trusted<Generator>::value;
+
+		// Sets s to the next integer, and returns false if gen would block.
+		bool next(result_type & s)
+		{
+			typename Range::input_type g;
+			if (!generate(gen, g))
+				return false;
+			s = (result_type)(g - in.min());
+			return true;
+		}
+	};
+
+	// A source of single bits, which buffers the output of a generator
+	// whose range is a power of 2 in "buffer".
+	// Range is runtime_range or constant_range.
+	template<typename Range, typename Generator>
+	struct binary_source
+	{
+		entropy_converter & c;
+		Generator & gen;
+		Range in;
+
+		static constexpr bool checked = !is_trusted<Generator>::value;
+
+		// The number of bits in each output of gen.
+		int bits() const { return bit_width(in.max() - in.min()); }
+
+		// Reads the next output of gen into the buffer, and returns false if gen would block.
+		bool load()
+		{
+			typename Range::input_type g;
+			if (!generate(gen, g))
+				return false;
+			if (checked)
+			{
+				if (g < in.min())
+					ErrorPolicy::raise("Input value too small");
+				if (g > in.max())
+					ErrorPolicy::raise("Input value too large");
+			}
+			c.buffer = (buffer_type)(g - in.min());
+			c.buffer_max = (buffer_type)(in.max() - in.min());
+			return true;
+		}
+
+		// Sets r to n bits, reading gen at most once, and returns false if gen would block.
+		// n must be no more than the number of bits of gen.
+		bool take_bits(int n, result_type & r)
+		{
+			int buffered = bit_width(c.buffer_max);
+			if (buffered >= n)
+			{
+				r = take(n);
+				return true;
+			}
+			auto low = (result_type)c.buffer;
+			if (!load())
+				return false;
+			r = low | (take(n - buffered) << buffered);
+			return true;
+		}
+
+		// Takes n bits from the buffer, which must contain at least n bits.
+		result_type take(int n)
+		{
+			if (n == std::numeric_limits<buffer_type>::digits)
+			{
+				auto r = (result_type)c.buffer;
+				c.buffer = c.buffer_max = 0;
+				return r;
+			}
+			auto r = (result_type)(c.buffer & (((buffer_type)1 << n) - 1));
+			c.buffer >>= n;
+			c.buffer_max >>= n;
+			return r;
+		}
+
+		result_type operator()()
+		{
+			if (c.buffer_max == 0)
+				load();
+			auto r = c.buffer & 1;
+			c.buffer >>= 1;
+			c.buffer_max >>= 1;
+			return r;
+		}
+	};
+
+	// Loads the next input into "buffer" if it is empty. Returns true if it was loaded.
+	template<typename Range, typename Generator>
+	bool load_buffer(binary_source<Range, Generator> & source)
+	{
+		return buffer_max == 0 && source.load();
+	}
+
+	// Other sources are not buffered.
+	template<typename Source>
+	bool load_buffer(Source &)
+	{
+		return false;
+	}
+
+	// Reads bits from source until "range" is at least threshold.
+	// This gives the same "range" as reading one bit at a time, but moves as many
+	// bits as possible from "buffer" to "value" in a single shift.
+	// Returns false if source would block first.
+	template<typename Range, typename Generator>
+	bool fill(result_type, result_type threshold, binary_source<Range, Generator> & source)
+	{
+		while (range < threshold)
+		{
+			if (buffer_max == 0 && !source.load())
+				return false;
+
+			// The number of doublings of "range" needed to reach the threshold.
+			int needed = bit_width(threshold) - bit_width(range);
+			if ((range << needed) < threshold)
+				++needed;
+
+			int n = std::min(needed, bit_width(buffer_max));
+			if (n == std::numeric_limits<buffer_type>::digits)
+			{
+				value = (value << n) | (result_type)buffer;
+				buffer = buffer_max = 0;
+			}
+			else
+			{
+				value = (value << n) | (result_type)(buffer & (((buffer_type)1 << n) - 1));
+				buffer >>= n;
+				buffer_max >>= n;
+			}
+			range <<= n;
+		}
+		return true;
+	}
+
+	// Reads entropy from source until "range" is at least threshold.
+	// Returns false if source would block first.
+	template<typename Source>
+	bool fill(result_type src_range, result_type threshold, Source & source)
+	{
+		// With eager_refill, read as much entropy as possible up-front.
+		// This is counterintuitive but gives a very high conversion efficiency.
+		while (range < threshold)
+		{
+			result_type s;
+			if (!source.next(s))
+				return false;
+			if (Source::checked)
+			{
+				if (s < 0)
+					ErrorPolicy::raise("Input is too small");
+				if (s >= src_range)
+					ErrorPolicy::raise("Input is too large");
+			}
+			value = value * src_range + s;
+			range *= src_range;
+		}
+		return true;
+	}
+
 	// Reads entropy from source and returns a uniform random number in the range [0,target)
-	// source is a functor that returns an integer in the range [0,src_range)
-	// limit specifies the maximum size of the entropy to buffer.
+	// source supplies integers in the range [0,src_range)
+	// threshold is limit/src_range, where limit is the maximum range of the entropy to buffer.
+	// It is computed once by the caller so that refilling "value" does not divide.
+	// Returns target if source would block, in which case no entropy is lost.
+	// Only sources that read a nonblocking_generator can block.
 	template<typename Source>
-	result_type convert_from_source(result_type target, result_type src_range, result_type limit, Source source)
+	result_type convert_from_source(result_type target, result_type src_range, result_type threshold, Source & source)
 	{
-		if (target > limit / src_range)
-			throw std::range_error("The output range is too large");
+		return convert_from_value(target, src_range, threshold, source);
+	}
 
-		for (;;)
+	// convert_from_source for a binary source.
+	// A target of 2^k*odd is split so that the 2^k part is read directly from "buffer",
+	// which does not lose any entropy, and only the odd part is converted through "value".
+	// The smaller target means a lower chance of rejection.
+	template<typename Range, typename Generator>
+	result_type convert_from_source(result_type target, result_type src_range, result_type threshold, binary_source<Range, Generator> & source)
+	{
+		const int k = bit_width(target & (0 - target)) - 1;
+		if (k == 0 || k > source.bits() || target > threshold)
+			return convert_from_value(target, src_range, threshold, source);
+
+		const result_type odd = target >> k;
+		result_type r = 0, bits;
+		if (odd > 1 && (r = convert_from_value(odd, src_range, threshold, source)) == odd)
+			return target;
+		bool ok;
+#if ECONV_EXCEPTIONS
+		try
+		{
+			ok = source.take_bits(k, bits);
+		}
+		catch (...)
+		{
+			// Reading gen failed, so put r back into "value" to avoid losing its entropy.
+			value = value * odd + r;
+			range *= odd;
+			throw;
+		}
+#else
+		ok = source.take_bits(k, bits);
+#endif
+		if (!ok)
 		{
-			// Read as much entropy as possible up-front.
-			// This is counterintuitive but gives a very high conversion efficiency.
-			while (range < limit / src_range)
+			// gen would block, so put r back into "value" to avoid losing its entropy.
+			value = value * odd + r;
+			range *= odd;
+			return target;
+		}
+		return (r << k) | bits;
+	}
+
+	// Reads entropy from source and returns a uniform random number in the range [0,target),
+	// where the entropy is buffered in "value". Returns target if source would block.
+	template<typename Source>
+	result_type convert_from_value(result_type target, result_type src_range, result_type threshold, Source & source)
+	{
+		if (target > threshold)
+			ErrorPolicy::raise("The output range is too large");
+		const result_type fill_threshold = RefillPolicy::threshold(target, threshold);
+
+		// If source would block, "value" may not reach fill_threshold. Converting with a range
+		// just above target would often reject and lose entropy, so only convert once the
+		// chance of a rejection is less than 2^-8.
+		const result_type min_range = std::min(fill_threshold, lazy_refill<8>::threshold(target, threshold));
+
+		if ((target & (target - 1)) == 0)
+		{
+			// Powers of 2 use masks and shifts instead of division.
+			// If "range" is also a power of 2, then new_range==range and the result is never rejected.
+			const int shift = bit_width(target) - 1;
+			const result_type mask = target - 1;
+			for (;;)
 			{
-				result_type s = (result_type)source();
-				if (s < 0) throw
-					std::range_error("Input is too small");
-				if (s >= src_range) throw
-					std::range_error("Input is too large");
-				value = value * src_range + s;
-				range *= src_range;
+				if (!fill(src_range, fill_threshold, source) && range < min_range)
+					return target;
+				result_type new_range = range & ~mask;
+				if (value < new_range)
+				{
+					result_type r = value & mask;
+					value >>= shift;
+					range = new_range >> shift;
+					return r;
+				}
+				value -= new_range;
+				range -= new_range;
 			}
+		}
+
+		for (;;)
+		{
+			if (!fill(src_range, fill_threshold, source) && range < min_range)
+				return target;
 
 			// "new_range" is the highest multiple of target <= range
 			result_type new_range = range - range % target;
@@ -227,6 +987,228 @@ private:
 		}
 	}
 
+	// Reads entropy from source and writes a uniform random number in [0,t) to out for each t in [first,last).
+	// Targets are grouped while their product fits in half of result_type, to keep conversion efficient.
+	template<typename ForwardIt, typename OutputIt, typename Source>
+	OutputIt digits_from_source(ForwardIt first, ForwardIt last, OutputIt out, result_type src_range, result_type threshold, Source & source)
+	{
+		const result_type max = std::min<result_type>((result_type)1 << (std::numeric_limits<result_type>::digits / 2), threshold);
+
+		while (first != last)
+		{
+			// Find the longest run of targets whose product is at most max.
+			auto group_end = first;
+			result_type product = 1;
+			do
+			{
+				result_type t = *group_end;
+				if (t <= 0)
+					ErrorPolicy::raise("Output range is invalid");
+				if (product > 1 && t > max / product)
+					break;
+				product *= t;
+			}
+			while (++group_end != last);
+
+			result_type r = convert_from_source(product, src_range, threshold, source);
+			for (; first != group_end; ++first)
+			{
+				result_type t = *first;
+				*out++ = r % t;
+				r /= t;
+			}
+		}
+		return out;
+	}
+
+	// Reads entropy from source and writes n uniform random numbers in [0,t) to out, where t > 1.
+	// Outputs are read in blocks of k, where t^k fits in half of result_type, to keep conversion efficient.
+	template<typename OutputIt, typename Source>
+	OutputIt digits_n_from_source(result_type t, OutputIt out, std::size_t n, result_type src_range, result_type threshold, Source & source)
+	{
+		const result_type max = std::min<result_type>((result_type)1 << (std::numeric_limits<result_type>::digits / 2), threshold);
+		std::size_t k = 1;
+		result_type power = t;
+		while (power <= max / t)
+			power *= t, ++k;
+
+#ifdef __SIZEOF_INT128__
+		// power is compared in result_type, which can be wider than 64 bits.
+		// Since t >= 2 and power <= 2^32, k <= 32.
+		const std::size_t max_k = 32;
+		if (k > 1 && k <= max_k && (std::numeric_limits<result_type>::digits <= 32 || power <= (result_type)(std::uint64_t(1) << 32)))
+		{
+			// Splitting a block with x%t and x/=t is a chain of dependent divisions.
+			// Instead, digit i is (x/t^i)%t, where both operations are computed by multiplying
+			// by a precomputed reciprocal (Lemire's fastmod), which is exact for 32-bit x and t^i.
+			__extension__ typedef unsigned __int128 wide;
+			std::uint64_t reciprocal[max_k];
+			const std::uint64_t t_reciprocal = ~std::uint64_t(0) / t + 1;
+			std::uint64_t p = 1;
+			for (std::size_t i = 1; i < k; ++i)
+			{
+				p *= t;
+				reciprocal[i] = ~std::uint64_t(0) / p + 1;
+			}
+
+			for (; n >= k; n -= k)
+			{
+				std::uint64_t x = convert_from_source(power, src_range, threshold, source);
+				*out++ = (result_type)(((wide)(t_reciprocal * x) * t) >> 64);
+				for (std::size_t i = 1; i < k; ++i)
+				{
+					auto q = (std::uint64_t)(((wide)reciprocal[i] * x) >> 64);
+					*out++ = (result_type)(((wide)(t_reciprocal * q) * t) >> 64);
+				}
+			}
+		}
+#endif
+
+		for (; n > 0; n -= k)
+		{
+			if (n < k)
+			{
+				k = n;
+				power = t;
+				for (std::size_t i = 1; i < k; ++i)
+					power *= t;
+			}
+			result_type x = convert_from_source(power, src_range, threshold, source);
+			for (std::size_t i = 0; i < k; ++i, x /= t)
+				*out++ = x % t;
+		}
+		return out;
+	}
+
+	// Reads entropy from source and returns true with probability a/b, where 0 < a < b.
+	// Rather than reading a whole uniform number in [0,b), this compares "value"
+	// against range*a/b, and keeps the entropy on whichever side "value" falls.
+	template<typename Source>
+	bool bernoulli_from_source(result_type a, result_type b, result_type src_range, result_type threshold, Source & source)
+	{
+		const result_type fill_threshold = RefillPolicy::threshold(b, threshold);
+		for (;;)
+		{
+			fill(src_range, fill_threshold, source);
+
+			// [0,lo) is true, [hi,range) is false, and lo straddles the boundary if rem>0.
+			result_type rem;
+			result_type lo = mul_div(range, a, b, rem);
+			result_type hi = lo + (rem != 0);
+
+			if (value < lo)
+			{
+				range = lo;
+				return true;
+			}
+			else if (value >= hi)
+			{
+				value -= hi;
+				range -= hi;
+				return false;
+			}
+			else
+			{
+				// value==lo is true with probability rem/b.
+				value = 0;
+				range = 1;
+				a = rem;
+			}
+		}
+	}
+
+	// Reads n bits of entropy from source, for n <= 64.
+	// The bits are read in chunks of up to half of result_type to keep conversion efficient.
+	template<typename Source>
+	std::uint64_t bits_from_source(int n, result_type src_range, result_type threshold, Source & source)
+	{
+		int chunk = std::numeric_limits<result_type>::digits / 2;
+		while (chunk > 1 && ((result_type)1 << chunk) > threshold)
+			--chunk;
+
+		std::uint64_t r = 0;
+		for (; n > 0; n -= chunk)
+		{
+			if (chunk > n) chunk = n;
+			r = (r << chunk) | convert_from_source((result_type)1 << chunk, src_range, threshold, source);
+		}
+		return r;
+	}
+
+	// Reads entropy from source and returns a uniform random real number in [a,b)
+	template<typename Real, typename Source>
+	Real real_from_source(Real a, Real b, result_type src_range, result_type threshold, Source & source)
+	{
+		static_assert(std::numeric_limits<Real>::digits <= 64, "Real has too many digits");
+		const int D = std::numeric_limits<Real>::digits;
+		for (;;)
+		{
+			Real u = std::ldexp(Real(bits_from_source(D, src_range, threshold, source)), -D);
+			Real r = a + (b - a) * u;
+			// Rounding can give b, in which case we try again.
+			if (r < b) return r;
+		}
+	}
+
+	// Returns the number of bits needed to represent x.
+	template<typename U>
+	static int bit_width(U x)
+	{
+#ifdef __GNUC__
+		if (sizeof(U) <= sizeof(unsigned long long))
+			return x ? std::numeric_limits<unsigned long long>::digits - __builtin_clzll((unsigned long long)x) : 0;
+#endif
+		int n = 0;
+		for (; x; x >>= 1)
+			++n;
+		return n;
+	}
+
+	// Returns x*y/z and sets rem to x*y%z, where y <= z, so that the result is at most x.
+	// x can be much larger than z, for example when x is the range and y/z is a probability.
+	static result_type mul_div(result_type x, result_type y, result_type z, result_type & rem)
+	{
+		return mul_div(x, y, z, rem, std::integral_constant<bool, sizeof(result_type) <= sizeof(std::uint32_t)>());
+	}
+
+	// mul_div using a 64-bit product.
+	static result_type mul_div(result_type x, result_type y, result_type z, result_type & rem, std::true_type)
+	{
+		std::uint64_t p = (std::uint64_t)x * y;
+		rem = (result_type)(p % z);
+		return (result_type)(p / z);
+	}
+
+	// mul_div without overflowing result_type.
+	static result_type mul_div(result_type x, result_type y, result_type z, result_type & rem, std::false_type)
+	{
+#ifdef __SIZEOF_INT128__
+		if (sizeof(result_type) <= sizeof(std::uint64_t))
+		{
+			__extension__ typedef unsigned __int128 wide;
+			wide p = (wide)x * y;
+			rem = (result_type)(p % z);
+			return (result_type)(p / z);
+		}
+#endif
+		// Double-and-add over the bits of y, keeping the product as q*z+r with r<z.
+		result_type q = 0, r = 0, xq = x / z, xr = x % z;
+		for (int bit = std::numeric_limits<result_type>::digits - 1; bit >= 0; --bit)
+		{
+			q *= 2;
+			if (r >= z - r) r -= z - r, ++q;
+			else r *= 2;
+			if ((y >> bit) & 1)
+			{
+				q += xq;
+				if (r >= z - xr) r -= z - xr, ++q;
+				else r += xr;
+			}
+		}
+		rem = r;
+		return q;
+	}
+
 	// Stores entropy.
 	// "value" is a uniform random integer in [0,range)
 	// "buffer" is a uniform random integer in [0,buffer_max].
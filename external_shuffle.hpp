@@ -0,0 +1,419 @@
+// Shuffles files of records that are too large to fit in memory.
+// Records are either fixed-size, or delimited by newlines.
+//
+// The input is read sequentially, and each record is appended to a uniformly
+// random bucket, where each bucket is a temporary file. Each bucket is then
+// shuffled in memory using Fisher-Yates and appended to the output.
+// Buckets that are still too large for memory are shuffled recursively.
+//
+// Sending each record to an independent uniform bucket, and then shuffling
+// each bucket uniformly, gives a perfectly uniform permutation of the file.
+//
+// Example:
+//
+// entropy_converter<std::uint64_t> c;
+// std::random_device d;
+// econv::shuffle_options options;
+// options.memory_limit = 1 << 30;
+// econv::shuffle_file("in.txt", "out.txt", options, c, d);
+
+#pragma once
+
+#include "entropy_converter.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace econv
+{
+	// Controls how a file is shuffled.
+	struct shuffle_options
+	{
+		// The size of each record in bytes, or 0 for newline-delimited records.
+		std::size_t record_size = 0;
+
+		// The number of bytes of records to shuffle in memory.
+		// The peak memory use is about twice this.
+		std::size_t memory_limit = std::size_t(256) << 20;
+
+		// The maximum number of temporary files written at the same time.
+		// Buckets waiting to be shuffled are closed if temp_directory is set, so at most
+		// max_buckets, plus one for each level of recursion, are open at once.
+		std::size_t max_buckets = 256;
+
+		// Where to write temporary files. If empty, std::tmpfile() is used,
+		// and these files stay open until they are shuffled, because they cannot be reopened.
+		std::string temp_directory;
+	};
+
+	namespace detail
+	{
+		typedef std::unique_ptr<std::FILE, int(*)(std::FILE*)> file_ptr;
+
+		// Reports an I/O error by throwing std::runtime_error, or calls std::abort() when exceptions are disabled.
+		[[noreturn]] inline void io_error(const std::string &message)
+		{
+#if ECONV_EXCEPTIONS
+			throw std::runtime_error(message);
+#else
+			(void)message;
+			std::abort();
+#endif
+		}
+
+		// The size of a stream whose size is not yet known.
+		const std::uint64_t unknown_size = ~std::uint64_t(0);
+
+		inline void write(std::FILE *file, const char *data, std::size_t size)
+		{
+			if (std::fwrite(data, 1, size, file) != size)
+				detail::io_error("Error writing file");
+		}
+
+		// A temporary file that is deleted when it is destroyed.
+		// Writes are buffered in memory until finish(), which frees the buffer.
+		// A named file is then closed until read(), so that buckets waiting to be
+		// shuffled do not hold a file open.
+		class temp_file
+		{
+		public:
+			temp_file(const std::string &directory, std::size_t buffer_size) : file(nullptr, &std::fclose)
+			{
+				if (directory.empty())
+				{
+					file.reset(std::tmpfile());
+				}
+				else
+				{
+					static unsigned counter = 0;
+					for (int attempt = 0; attempt < 100 && !file; ++attempt)
+					{
+						path = directory + "/econv_shuffle_" + std::to_string((std::size_t)this) + "_" + std::to_string(counter++) + ".tmp";
+						file.reset(std::fopen(path.c_str(), "w+bx"));
+					}
+				}
+				if (!file)
+					detail::io_error("Cannot create temporary file");
+				std::setvbuf(file.get(), nullptr, _IONBF, 0);
+				buffer.reserve(buffer_size);
+			}
+
+			temp_file(temp_file &&other) : buffer(std::move(other.buffer)), file(std::move(other.file)), path(std::move(other.path))
+			{
+				other.path.clear();
+			}
+
+			~temp_file()
+			{
+				close();
+			}
+
+			void write(const char *data, std::size_t size)
+			{
+				if (buffer.size() + size > buffer.capacity())
+					flush();
+				if (size > buffer.capacity())
+					detail::write(file.get(), data, size);
+				else
+					buffer.insert(buffer.end(), data, data + size);
+			}
+
+			// Writes the buffered data, frees the buffer, and closes a named file.
+			void finish()
+			{
+				flush();
+				std::vector<char>().swap(buffer);
+				if (std::fflush(file.get()) != 0 || std::ferror(file.get()))
+					detail::io_error("Error writing temporary file");
+				if (!path.empty() && std::fclose(file.release()) != 0)
+					detail::io_error("Error writing temporary file");
+			}
+
+			// Opens the file for reading from the start.
+			std::FILE *read()
+			{
+				if (file)
+				{
+					std::rewind(file.get());
+					return file.get();
+				}
+				file.reset(std::fopen(path.c_str(), "rb"));
+				if (!file)
+					detail::io_error("Cannot reopen temporary file");
+				std::setvbuf(file.get(), nullptr, _IONBF, 0);
+				return file.get();
+			}
+
+			// Closes and deletes the file.
+			void close()
+			{
+				file.reset();
+				if (!path.empty())
+				{
+					std::remove(path.c_str());
+					path.clear();
+				}
+			}
+
+		private:
+			void flush()
+			{
+				if (!buffer.empty())
+					detail::write(file.get(), &buffer[0], buffer.size());
+				buffer.clear();
+			}
+
+			std::vector<char> buffer;
+			file_ptr file;
+			std::string path;
+		};
+
+		// Reads records sequentially from a file, using a large buffer.
+		class record_reader
+		{
+		public:
+			record_reader(std::FILE *file, std::size_t record_size, std::size_t buffer_size) :
+				file(file), record_size(record_size), buffer(std::max(buffer_size, record_size)), begin(0), end(0), eof(false)
+			{
+			}
+
+			// Reads the next record, which remains valid until the next call.
+			// Newline-delimited records include their newline, except possibly the last record.
+			// Returns false at the end of the file.
+			bool next(const char *&data, std::size_t &size)
+			{
+				for (;;)
+				{
+					if (record_size)
+					{
+						if (end - begin >= record_size)
+						{
+							data = &buffer[begin];
+							size = record_size;
+							begin += record_size;
+							return true;
+						}
+					}
+					else
+					{
+						auto nl = (const char*)std::memchr(&buffer[0] + begin, '\n', end - begin);
+						if (nl)
+						{
+							data = &buffer[begin];
+							size = nl + 1 - data;
+							begin += size;
+							return true;
+						}
+					}
+
+					if (eof)
+					{
+						if (begin == end)
+							return false;
+						if (record_size)
+							detail::io_error("File size is not a multiple of the record size");
+						data = &buffer[begin];
+						size = end - begin;
+						begin = end;
+						return true;
+					}
+
+					fill();
+				}
+			}
+
+		private:
+			// Reads more of the file into the buffer, growing the buffer for long lines.
+			void fill()
+			{
+				if (begin > 0)
+				{
+					std::memmove(&buffer[0], &buffer[begin], end - begin);
+					end -= begin;
+					begin = 0;
+				}
+				if (end == buffer.size())
+					buffer.resize(buffer.size() * 2);
+				auto n = std::fread(&buffer[end], 1, buffer.size() - end, file);
+				end += n;
+				if (n == 0)
+				{
+					if (std::ferror(file))
+						detail::io_error("Error reading file");
+					eof = true;
+				}
+			}
+
+			std::FILE *file;
+			std::size_t record_size;
+			std::vector<char> buffer;
+			std::size_t begin, end;
+			bool eof;
+		};
+
+		// Records held in memory.
+		class record_block
+		{
+		public:
+			std::uint64_t bytes() const { return data.size(); }
+
+			std::size_t size() const { return starts.size(); }
+
+			void add(const char *record, std::size_t size, bool lines)
+			{
+				starts.push_back(data.size());
+				data.insert(data.end(), record, record + size);
+				if (lines && record[size - 1] != '\n')
+					data.push_back('\n');
+			}
+
+			// Write the records to 'out' in a uniformly random order.
+			template<typename Converter, typename Generator>
+			void shuffle_to(std::FILE *out, Converter &c, Generator &gen)
+			{
+				std::vector<std::size_t> order(starts.size());
+				for (std::size_t i = 0; i < order.size(); ++i)
+					order[i] = i;
+				for (std::size_t i = order.size(); i > 1; --i)
+					std::swap(order[i - 1], order[(std::size_t)c.convert((typename Converter::result_type)i, gen)]);
+
+				starts.push_back(data.size());
+				for (auto i : order)
+					write(out, &data[starts[i]], starts[i + 1] - starts[i]);
+				starts.pop_back();
+			}
+
+			template<typename Fn>
+			void for_each(Fn fn) const
+			{
+				for (std::size_t i = 0; i < starts.size(); ++i)
+					fn(&data[starts[i]], (i + 1 < starts.size() ? starts[i + 1] : data.size()) - starts[i]);
+			}
+
+			void clear()
+			{
+				std::vector<char>().swap(data);
+				std::vector<std::size_t>().swap(starts);
+			}
+
+		private:
+			std::vector<char> data;
+			std::vector<std::size_t> starts;
+		};
+
+		// Shuffles the records from 'in' and appends them to 'out'.
+		// 'size' and 'count' are the size of the input in bytes and records if known.
+		template<typename Converter, typename Generator>
+		void shuffle_stream(std::FILE *in, std::FILE *out, const shuffle_options &options, Converter &c, Generator &gen,
+			std::uint64_t size, std::uint64_t count)
+		{
+			const bool lines = options.record_size == 0;
+			const std::size_t memory = std::max<std::size_t>(options.memory_limit, 1);
+			record_reader reader(in, options.record_size, std::min<std::size_t>(memory, 1 << 20));
+			record_block block;
+			const char *record;
+			std::size_t record_bytes;
+
+			// Load as many records as will fit in memory.
+			bool more = false;
+			if (size == unknown_size || size <= memory || count <= 1)
+			{
+				while ((more = reader.next(record, record_bytes)))
+				{
+					if (block.size() > 0 && block.bytes() + record_bytes > memory)
+						break;
+					block.add(record, record_bytes, lines);
+				}
+			}
+			else
+			{
+				more = reader.next(record, record_bytes);
+			}
+
+			if (!more)
+			{
+				block.shuffle_to(out, c, gen);
+				return;
+			}
+
+			// Too large for memory, so distribute the records into random buckets.
+			std::size_t bucket_count = options.max_buckets;
+			if (size != unknown_size)
+				bucket_count = std::min<std::uint64_t>(bucket_count, 2 * (size / memory) + 2);
+			bucket_count = std::max<std::size_t>(bucket_count, 2);
+
+			std::vector<temp_file> buckets;
+			std::vector<std::uint64_t> bucket_sizes(bucket_count), bucket_counts(bucket_count);
+			buckets.reserve(bucket_count);
+			for (std::size_t i = 0; i < bucket_count; ++i)
+				buckets.emplace_back(options.temp_directory, std::max<std::size_t>(memory / bucket_count, 1 << 12));
+
+			auto distribute = [&](const char *data, std::size_t bytes)
+			{
+				auto b = (std::size_t)c.convert((typename Converter::result_type)bucket_count, gen);
+				buckets[b].write(data, bytes);
+				bucket_sizes[b] += bytes;
+				++bucket_counts[b];
+				if (lines && data[bytes - 1] != '\n')
+				{
+					buckets[b].write("\n", 1);
+					++bucket_sizes[b];
+				}
+			};
+
+			block.for_each(distribute);
+			block.clear();
+			do
+				distribute(record, record_bytes);
+			while (reader.next(record, record_bytes));
+
+			// Free the write buffers before any bucket is shuffled recursively.
+			for (auto &bucket : buckets)
+				bucket.finish();
+
+			// Shuffle each bucket in turn, and delete it once it is done.
+			for (std::size_t i = 0; i < bucket_count; ++i)
+			{
+				if (bucket_counts[i] > 0)
+					shuffle_stream(buckets[i].read(), out, options, c, gen, bucket_sizes[i], bucket_counts[i]);
+				buckets[i].close();
+			}
+		}
+	}
+
+	// Shuffles the records in 'in', and writes them to 'out'.
+	// Newline-delimited records are all written with a trailing newline.
+	// c is an entropy_converter, and gen is a uniform random number generator like std::random_device.
+	template<typename Converter, typename Generator>
+	void shuffle_records(std::FILE *in, std::FILE *out, const shuffle_options &options, Converter &c, Generator &gen)
+	{
+		detail::shuffle_stream(in, out, options, c, gen, detail::unknown_size, detail::unknown_size);
+		if (std::fflush(out) != 0 || std::ferror(out))
+			detail::io_error("Error writing file");
+	}
+
+	// Shuffles the records in the file 'input', and writes them to the file 'output'.
+	template<typename Converter, typename Generator>
+	void shuffle_file(const std::string &input, const std::string &output, const shuffle_options &options, Converter &c, Generator &gen)
+	{
+		std::vector<char> in_buffer(1 << 20), out_buffer(1 << 20);
+		detail::file_ptr in(std::fopen(input.c_str(), "rb"), &std::fclose);
+		if (!in)
+			detail::io_error("Cannot open input file " + input);
+		detail::file_ptr out(std::fopen(output.c_str(), "wb"), &std::fclose);
+		if (!out)
+			detail::io_error("Cannot open output file " + output);
+		std::setvbuf(in.get(), &in_buffer[0], _IOFBF, in_buffer.size());
+		std::setvbuf(out.get(), &out_buffer[0], _IOFBF, out_buffer.size());
+
+		shuffle_records(in.get(), out.get(), options, c, gen);
+
+		if (std::fclose(out.release()) != 0)
+			detail::io_error("Error writing file " + output);
+	}
+}
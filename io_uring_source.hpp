@@ -0,0 +1,383 @@
+// Reads entropy from a file descriptor using Linux io_uring, for example a hardware
+// random number generator such as /dev/hwrng, or a recording of entropy on disk.
+// Several large reads are kept in flight, and words are read directly from the
+// completed buffers, so the device can be read at full bandwidth while the converter runs.
+//
+// Example:
+//
+// int fd = open("/dev/hwrng", O_RDONLY);
+// econv::io_uring_entropy_source<> source(fd);
+// entropy_converter<std::uint64_t> c;
+// auto roll = c.convert(1, 6, source);
+//
+// It can also drive an async_entropy_converter, whose coroutines are resumed by process_completions():
+//
+// econv::async_entropy_converter<econv::io_uring_entropy_source<>> c(source);
+// ... start coroutines that co_await c.convert_async(1, 6) ...
+// while (source.process_completions())
+//     ;
+//
+// This uses the io_uring system calls directly, and does not need liburing.
+// It requires Linux 5.6 or later, and this header is empty on other systems.
+
+#pragma once
+
+#include "entropy_converter.hpp"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define ECONV_IO_URING 1
+#endif
+#endif
+
+#if ECONV_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace econv
+{
+	// A generator of uniform random Words, read from a file descriptor using io_uring.
+	// depth reads of block_size bytes are kept in flight. The bytes of the file are used
+	// in order if the file is seekable, such as a regular file, and in the order that the reads
+	// complete otherwise, such as a pipe or a device.
+	// The file descriptor is not closed by the source.
+	// Reading past the end of the file, or a read error, throws std::runtime_error.
+	template<typename Word = unsigned>
+	class io_uring_entropy_source
+	{
+	public:
+		typedef Word result_type;
+
+		static constexpr Word min() { return 0; }
+		static constexpr Word max() { return (Word)~Word(0); }
+
+		explicit io_uring_entropy_source(int fd, std::size_t block_size = 65536, unsigned depth = 4) :
+			fd(fd), block_size(block_size), blocks(depth), data(block_size * depth), current(0), pos(nullptr), end(nullptr), in_flight(0)
+		{
+			if (block_size == 0 || depth == 0)
+				throw std::runtime_error("Invalid io_uring buffer size");
+
+			io_uring_params params;
+			std::memset(&params, 0, sizeof(params));
+			ring = (int)syscall(__NR_io_uring_setup, depth, &params);
+			if (ring < 0)
+				throw std::runtime_error(std::string("io_uring_setup failed: ") + std::strerror(errno));
+
+			sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+			cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+			if (params.features & IORING_FEAT_SINGLE_MMAP)
+				sq_size = cq_size = std::max(sq_size, cq_size);
+			sqe_size = params.sq_entries * sizeof(io_uring_sqe);
+
+			sq_ptr = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQ_RING);
+			cq_ptr = params.features & IORING_FEAT_SINGLE_MMAP ? sq_ptr :
+				mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_CQ_RING);
+			sqes = (io_uring_sqe *)mmap(nullptr, sqe_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, IORING_OFF_SQES);
+			if (sq_ptr == MAP_FAILED || cq_ptr == MAP_FAILED || sqes == MAP_FAILED)
+			{
+				unmap();
+				close(ring);
+				throw std::runtime_error("Cannot map io_uring");
+			}
+
+			auto sq = (char *)sq_ptr, cq = (char *)cq_ptr;
+			sq_head = (unsigned *)(sq + params.sq_off.head);
+			sq_tail = (unsigned *)(sq + params.sq_off.tail);
+			sq_mask = *(unsigned *)(sq + params.sq_off.ring_mask);
+			sq_array = (unsigned *)(sq + params.sq_off.array);
+			cq_head = (unsigned *)(cq + params.cq_off.head);
+			cq_tail = (unsigned *)(cq + params.cq_off.tail);
+			cq_mask = *(unsigned *)(cq + params.cq_off.ring_mask);
+			cqes = (io_uring_cqe *)(cq + params.cq_off.cqes);
+
+			// Regular files are read at explicit offsets, so that the reads can complete in any order.
+			offset = lseek(fd, 0, SEEK_CUR);
+			seekable = offset >= 0;
+
+			try
+			{
+				for (unsigned i = 0; i < depth; ++i)
+					submit(i);
+			}
+			catch (...)
+			{
+				release();
+				throw;
+			}
+		}
+
+		io_uring_entropy_source(const io_uring_entropy_source &) = delete;
+		io_uring_entropy_source &operator=(const io_uring_entropy_source &) = delete;
+
+		~io_uring_entropy_source()
+		{
+			release();
+		}
+
+		// Returns the next word, waiting for a read to complete if necessary.
+		result_type operator()()
+		{
+			Word w;
+			if (end - pos >= (std::ptrdiff_t)sizeof(Word))
+			{
+				std::memcpy(&w, pos, sizeof(Word));
+				pos += sizeof(Word);
+				return w;
+			}
+			// The word spans two reads.
+			auto p = (unsigned char *)&w;
+			for (std::size_t i = 0; i < sizeof(Word); ++i)
+			{
+				while (pos == end)
+					next_block();
+				p[i] = *pos++;
+			}
+			return w;
+		}
+
+		// Sets x to the next word if it can be read without waiting, for try_convert().
+		bool try_generate(result_type & x)
+		{
+			if (!ready())
+				return false;
+			// If a read failed, this throws.
+			x = (*this)();
+			return true;
+		}
+
+		// Calls fn() from process_completions() once more input may be available,
+		// for async_entropy_converter.
+		template<typename Fn>
+		void when_ready(Fn fn)
+		{
+			waiting.emplace_back(std::move(fn));
+		}
+
+		// Calls the functions passed to when_ready() once a word can be read without waiting.
+		// If blocking is true, this waits for a read to complete, and otherwise it returns immediately,
+		// for example from an event loop when ring_fd() is readable.
+		// Returns the number of functions called, which is 0 if none are waiting.
+		std::size_t process_completions(bool blocking = true)
+		{
+			if (waiting.empty())
+				return 0;
+			while (!ready())
+			{
+				if (!blocking || in_flight == 0)
+					return 0;
+				wait(true);
+			}
+			auto ready_fns = std::move(waiting);
+			waiting.clear();
+			std::size_t i = 0;
+			try
+			{
+				for (; i < ready_fns.size(); ++i)
+					ready_fns[i]();
+			}
+			catch (...)
+			{
+				// Keep the functions that did not run, so that their coroutines can still be resumed.
+				waiting.insert(waiting.begin(), std::make_move_iterator(ready_fns.begin() + i + 1), std::make_move_iterator(ready_fns.end()));
+				throw;
+			}
+			return ready_fns.size();
+		}
+
+		// The io_uring file descriptor, which can be polled for completed reads.
+		int ring_fd() const { return ring; }
+
+	private:
+		// Whether a word can be read, or a read error reported, without waiting.
+		bool ready()
+		{
+			// Count the bytes in the current block, and in the following blocks that have completed.
+			std::size_t available = end - pos;
+			reap();
+			for (unsigned i = pos ? 1 : 0; available < sizeof(Word) && i < blocks.size(); ++i)
+			{
+				auto &b = blocks[(current + i) % blocks.size()];
+				if (b.pending)
+					break;
+				if (b.result <= 0)
+					return true;
+				available += b.result;
+			}
+			return available >= sizeof(Word);
+		}
+
+		struct block
+		{
+			block() : pending(false), result(0) { }
+			bool pending;
+			int result;
+		};
+
+		int fd, ring;
+		std::size_t block_size;
+		std::vector<block> blocks;
+		std::vector<unsigned char> data;
+		unsigned current;
+		const unsigned char *pos, *end;
+		unsigned in_flight;
+		off_t offset;
+		bool seekable;
+		std::vector<std::function<void()>> waiting;
+
+		void *sq_ptr = MAP_FAILED, *cq_ptr = MAP_FAILED;
+		std::size_t sq_size, cq_size, sqe_size;
+		io_uring_sqe *sqes = (io_uring_sqe *)MAP_FAILED;
+		io_uring_cqe *cqes;
+		unsigned *sq_head, *sq_tail, *sq_array, *cq_head, *cq_tail;
+		unsigned sq_mask, cq_mask;
+
+		// The user_data of a cancellation, which is not a block.
+		static const unsigned long long cancel_tag = ~0ull;
+
+		// Cancels the reads in flight and waits for them, because the kernel writes to the buffers
+		// until they complete. Reads from an idle pipe or device would otherwise never complete.
+		void release()
+		{
+			for (unsigned i = 0; i < blocks.size(); ++i)
+			{
+				if (!blocks[i].pending || *sq_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE) > sq_mask)
+					continue;
+				io_uring_sqe &sqe = prepare();
+				sqe.opcode = IORING_OP_ASYNC_CANCEL;
+				sqe.fd = -1;
+				sqe.addr = i;
+				sqe.user_data = cancel_tag;
+				push();
+			}
+			while (in_flight > 0 && wait(false))
+				;
+			unmap();
+			close(ring);
+		}
+
+		void unmap()
+		{
+			if (sqes != MAP_FAILED)
+				munmap(sqes, sqe_size);
+			if (cq_ptr != MAP_FAILED && cq_ptr != sq_ptr)
+				munmap(cq_ptr, cq_size);
+			if (sq_ptr != MAP_FAILED)
+				munmap(sq_ptr, sq_size);
+		}
+
+		// Returns the next entry of the submission queue, which is queued by push().
+		io_uring_sqe &prepare()
+		{
+			unsigned index = *sq_tail & sq_mask;
+			io_uring_sqe &sqe = sqes[index];
+			std::memset(&sqe, 0, sizeof(sqe));
+			sq_array[index] = index;
+			return sqe;
+		}
+
+		void push()
+		{
+			__atomic_store_n(sq_tail, *sq_tail + 1, __ATOMIC_RELEASE);
+		}
+
+		// Submits the queued entries, and waits for min_complete reads to complete.
+		// Entries that the kernel does not accept stay queued, and are submitted by the next call.
+		// Returns false on an error, or throws if raise is true.
+		bool enter(unsigned min_complete, bool raise)
+		{
+			for (;;)
+			{
+				unsigned queued = *sq_tail - __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+				if (syscall(__NR_io_uring_enter, ring, queued, min_complete, min_complete ? IORING_ENTER_GETEVENTS : 0, nullptr, 0) >= 0)
+					return true;
+				if (errno == EINTR)
+					continue;
+				if (raise)
+					throw std::runtime_error(std::string("io_uring_enter failed: ") + std::strerror(errno));
+				return false;
+			}
+		}
+
+		// Starts a read into block i.
+		// The block is pending as soon as the read is queued, even if submitting it fails,
+		// because the kernel may still read into it after a later call to enter().
+		void submit(unsigned i)
+		{
+			io_uring_sqe &sqe = prepare();
+			sqe.opcode = IORING_OP_READ;
+			sqe.fd = fd;
+			sqe.addr = (unsigned long long)&data[i * block_size];
+			sqe.len = (unsigned)block_size;
+			sqe.off = seekable ? (unsigned long long)offset : (unsigned long long)-1;
+			sqe.user_data = i;
+			if (seekable)
+				offset += block_size;
+			blocks[i].pending = true;
+			++in_flight;
+			push();
+			enter(0, true);
+		}
+
+		// Records the reads that have completed, without waiting.
+		void reap()
+		{
+			unsigned head = *cq_head;
+			for (; head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE); ++head)
+			{
+				const io_uring_cqe &cqe = cqes[head & cq_mask];
+				if (cqe.user_data == cancel_tag)
+					continue;
+				auto &b = blocks[(std::size_t)cqe.user_data];
+				b.pending = false;
+				b.result = cqe.res;
+				--in_flight;
+			}
+			__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+		}
+
+		// Waits for at least one read to complete. Returns false on an error, or throws if raise is true.
+		bool wait(bool raise)
+		{
+			if (!enter(1, raise))
+				return false;
+			reap();
+			return true;
+		}
+
+		// Moves to the next block once the current block is used up,
+		// and starts a new read into the current block.
+		void next_block()
+		{
+			if (pos != nullptr)
+			{
+				submit(current);
+				current = (current + 1) % blocks.size();
+			}
+			auto &b = blocks[current];
+			while (b.pending)
+				wait(true);
+			if (b.result < 0)
+				throw std::runtime_error(std::string("Error reading entropy: ") + std::strerror(-b.result));
+			if (b.result == 0)
+				throw std::runtime_error("End of entropy source");
+			pos = &data[current * block_size];
+			end = pos + b.result;
+		}
+	};
+}
+
+// Every word that is read is valid, so the outputs do not need to be checked.
+template<typename Word>
+struct is_trusted_generator<econv::io_uring_entropy_source<Word>> : std::true_type {};
+#endif
@@ -0,0 +1,167 @@
+// Uniform random permutations of small sets using entropy_converter.
+// When n! fits in the converter's result_type, a permutation is chosen with a
+// single call to convert(n!), and decoded using the factorial number system.
+//
+// Example: schedule 10 test cases in a random order.
+//
+// entropy_converter<std::uint64_t> c;
+// std::random_device d;
+// int order[10];
+// econv::random_permutation(c, 10, order, d);
+//
+// auto index = econv::random_permutation_index(c, 10, d);
+// econv::unrank_permutation(index, 10, order);
+// assert(econv::rank_permutation<std::uint64_t>(order, order + 10) == index);
+
+#pragma once
+
+#include "entropy_converter.hpp"
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace econv
+{
+	namespace detail
+	{
+		// Returns the table of 0!, 1!, ... n!, for all n! that fit in T.
+		template<typename T>
+		const std::vector<T> &factorial_table()
+		{
+			static const std::vector<T> table = []()
+			{
+				std::vector<T> t(1, 1);
+				for (T n = 1; t.back() <= std::numeric_limits<T>::max() / n; ++n)
+					t.push_back(t.back() * n);
+				return t;
+			}();
+			return table;
+		}
+	}
+
+	// The largest n where n! fits in T.
+	template<typename T>
+	unsigned max_permutation_size()
+	{
+		return (unsigned)detail::factorial_table<T>().size() - 1;
+	}
+
+	// Returns n!, which is the number of permutations of n items.
+	// Raises an error using ErrorPolicy if n! does not fit in T.
+	template<typename T, typename ErrorPolicy = default_error_policy>
+	T factorial(unsigned n)
+	{
+		auto &table = detail::factorial_table<T>();
+		if (n >= table.size())
+			ErrorPolicy::raise("Permutation is too large");
+		return table[n];
+	}
+
+	// Writes the permutation of [0,n) with lexicographic rank 'index' to 'out'.
+	// index is in the range [0,n!). Rank 0 is 0,1,2,...,n-1, and rank n!-1 is n-1,...,1,0.
+	template<typename ErrorPolicy = default_error_policy, typename T, typename OutputIt>
+	OutputIt unrank_permutation(T index, unsigned n, OutputIt out)
+	{
+		if (n == 0)
+			return out;
+		if (index >= factorial<T, ErrorPolicy>(n))
+			ErrorPolicy::raise("Permutation index is out of range");
+
+		auto &f = detail::factorial_table<T>();
+		if (n <= 16)
+		{
+			// The unused items are packed in 4-bit fields of 'items', in increasing order.
+			// Taking the d'th item shifts the items above it down, without branches.
+			std::uint64_t items = 0xfedcba9876543210;
+			for (unsigned i = n; i-- > 0;)
+			{
+				auto d = (unsigned)(index / f[i]);
+				index -= d * f[i];
+				auto shift = 4 * d;
+				auto below = (std::uint64_t(1) << shift) - 1;
+				*out++ = (typename std::iterator_traits<OutputIt>::value_type)((items >> shift) & 0xf);
+				items = (items & below) | ((items >> shift >> 4) << shift);
+			}
+		}
+		else
+		{
+			std::vector<unsigned> items(n);
+			for (unsigned i = 0; i < n; ++i)
+				items[i] = i;
+			for (unsigned i = n; i-- > 0;)
+			{
+				auto d = (unsigned)(index / f[i]);
+				index -= d * f[i];
+				*out++ = (typename std::iterator_traits<OutputIt>::value_type)items[d];
+				items.erase(items.begin() + d);
+			}
+		}
+		return out;
+	}
+
+	// Returns the lexicographic rank of the permutation of [0,n) in [first,last),
+	// which is the inverse of unrank_permutation().
+	// Raises an error using ErrorPolicy if the items are not a permutation of [0,n), or n! does not fit in T.
+	template<typename T, typename ErrorPolicy = default_error_policy, typename RandomIt>
+	T rank_permutation(RandomIt first, RandomIt last)
+	{
+		auto n = (unsigned)(last - first);
+		auto &f = detail::factorial_table<T>();
+		if (n >= f.size())
+			ErrorPolicy::raise("Permutation is too large");
+
+		std::uint64_t used = 0;
+		T index = 0;
+		for (unsigned i = 0; i < n; ++i)
+		{
+			auto x = (std::uint64_t)first[i];
+			if (x >= n || (used >> x) & 1)
+				ErrorPolicy::raise("Not a permutation");
+			used |= std::uint64_t(1) << x;
+
+			// The Lehmer digit is the number of later items that are smaller.
+			T d = 0;
+			for (unsigned j = i + 1; j < n; ++j)
+				d += (std::uint64_t)first[j] < x;
+			index += d * f[n - 1 - i];
+		}
+		return index;
+	}
+
+	// Returns a uniform random integer in [0,n!), which is the index of a permutation of n items.
+	// c is an entropy_converter, and gen is a uniform random number generator like std::random_device.
+	// Raises an error using c's error policy if n! is too large for the converter.
+	template<typename Converter, typename Generator>
+	typename Converter::result_type random_permutation_index(Converter &c, unsigned n, Generator &gen)
+	{
+		typedef typename Converter::result_type T;
+		return c.convert(factorial<T, typename Converter::error_policy>(n), gen);
+	}
+
+	// Writes a uniform random permutation of [0,n) to 'out', using a single call to convert(n!).
+	template<typename Converter, typename OutputIt, typename Generator>
+	OutputIt random_permutation(Converter &c, unsigned n, OutputIt out, Generator &gen)
+	{
+		return unrank_permutation<typename Converter::error_policy>(random_permutation_index(c, n, gen), n, out);
+	}
+
+	// Shuffles [first,last) uniformly, using a single call to convert(n!).
+	// The mixed-radix digits of the index are the swaps of a Fisher-Yates shuffle.
+	template<typename Converter, typename RandomIt, typename Generator>
+	void permute(Converter &c, RandomIt first, RandomIt last, Generator &gen)
+	{
+		typedef typename Converter::result_type T;
+		auto n = (unsigned)(last - first);
+		if (n < 2)
+			return;
+		auto index = random_permutation_index(c, n, gen);
+		for (unsigned i = n; i > 1; --i)
+		{
+			using std::swap;
+			swap(first[i - 1], first[(std::size_t)(index % (T)i)]);
+			index /= (T)i;
+		}
+	}
+}
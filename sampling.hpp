@@ -0,0 +1,245 @@
+// Sampling without replacement using entropy_converter.
+//
+// Example:
+//
+// entropy_converter<std::uint64_t> c;
+// std::random_device d;
+// std::vector<std::uint64_t> rows;
+// econv::sample(c, 1000, 1000000000, std::back_inserter(rows), d);
+//
+// econv::reservoir_sampler<std::string> lines(100);
+// for (std::string line; std::getline(std::cin, line); )
+//     lines.push(line, c, d);
+
+#pragma once
+
+#include "entropy_converter.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+namespace econv
+{
+	namespace detail
+	{
+		// Writes the integers in [0,n) that are (or are not) in 'chosen', in increasing order.
+		// 'chosen' is sorted.
+		template<typename T, typename OutputIt>
+		OutputIt write_sorted(const std::vector<T> &chosen, T n, bool complement, OutputIt out)
+		{
+			if (!complement)
+				return std::copy(chosen.begin(), chosen.end(), out);
+			auto next = chosen.begin();
+			for (T i = 0; i < n; ++i)
+			{
+				if (next != chosen.end() && *next == i)
+					++next;
+				else
+					*out++ = i;
+			}
+			return out;
+		}
+
+		// Returns the binomial coefficient C(n,k), or 0 if it does not fit in 62 bits.
+		inline std::uint64_t binomial_coefficient(std::uint64_t n, std::uint64_t k)
+		{
+			const std::uint64_t max = std::uint64_t(1) << 62;
+			if (k > n) return 0;
+			if (k > n - k) k = n - k;
+			std::uint64_t r = 1;
+			for (std::uint64_t i = 1; i <= k; ++i)
+			{
+				// r*(n-k+i)/i is exact, so divide out common factors first to avoid overflow.
+				std::uint64_t x = n - k + i, g = i, t = r;
+				while (t) { auto u = g % t; g = t; t = u; }
+				std::uint64_t r2 = r / g, i2 = i / g;
+				x /= i2;
+				if (x && r2 > max / x) return 0;
+				r = r2 * x;
+			}
+			return r;
+		}
+
+		// Sets 'chosen' to the combination of chosen.size() integers from [0,n) with the given rank
+		// in colexicographic order, in increasing order. r < C(n, chosen.size()), which must fit in 62 bits.
+		template<typename T>
+		void unrank_combination(std::uint64_t r, T n, std::vector<T> &chosen)
+		{
+			T hi = n;
+			for (T j = (T)chosen.size(); j > 0; --j)
+			{
+				// Find the largest c < hi with C(c,j) <= r. C(j-1,j) = 0.
+				T lo = j - 1, top = hi - 1;
+				while (lo < top)
+				{
+					T mid = lo + (top - lo + 1) / 2;
+					if (binomial_coefficient(mid, j) <= r)
+						lo = mid;
+					else
+						top = mid - 1;
+				}
+				r -= binomial_coefficient(lo, j);
+				chosen[j - 1] = hi = lo;
+			}
+		}
+
+		// Returns a uniform random double in (0,1], with 53 bits of entropy.
+		template<typename Converter, typename Generator>
+		double positive_unit_real(Converter &c, Generator &gen)
+		{
+			return 1.0 - c.uniform_real(0.0, 1.0, gen);
+		}
+	}
+
+	// Chooses k distinct integers uniformly at random from [0,n),
+	// and writes them to 'out' in increasing order.
+	// c is an entropy_converter, and gen is a uniform random number generator like std::random_device.
+	//
+	// Let m = min(k, n-k). Dense samples (m > n/4) decide whether to take each integer in turn
+	// using bernoulli, in O(n) time. Sparse samples draw the rank of the combination with a single call
+	// to convert when C(n,m) fits in half of result_type, and unrank it in O(m^2 log n) time.
+	// Both read log2 C(n,k) bits of entropy, plus the small loss of each conversion.
+	// Larger sparse samples use Floyd's algorithm with a hash set, which makes m calls to convert
+	// and takes O(m log m) time to sort, but reads log2(n!/(n-m)!) bits, which is log2(m!) bits more
+	// than log2 C(n,k). When k > n/2, the n-k integers that are not in the sample are chosen instead.
+	template<typename Converter, typename OutputIt, typename Generator>
+	OutputIt sample(Converter &c, typename Converter::result_type k, typename Converter::result_type n, OutputIt out, Generator &gen)
+	{
+		typedef typename Converter::result_type T;
+		if (k > n)
+			Converter::error_policy::raise("Sample is larger than the population");
+
+		bool complement = k > n - k;
+		T m = complement ? n - k : k;
+
+		if (m > n / 4)
+		{
+			// Selection sampling: take i with probability (k - taken) / (n - i).
+			for (T i = 0, taken = 0; taken < k; ++i)
+				if (c.bernoulli(k - taken, n - i, gen))
+				{
+					*out++ = i;
+					++taken;
+				}
+			return out;
+		}
+
+		std::vector<T> chosen;
+		chosen.reserve(m);
+		const std::uint64_t combinations = detail::binomial_coefficient(n, m);
+		if (combinations != 0 && combinations <= (std::uint64_t)1 << (std::numeric_limits<T>::digits / 2))
+		{
+			chosen.resize(m);
+			detail::unrank_combination((std::uint64_t)c.convert((T)combinations, gen), n, chosen);
+		}
+		else
+		{
+			// Floyd's algorithm.
+			std::unordered_set<T> set(m);
+			for (T j = n - m; j < n; ++j)
+			{
+				auto t = c.convert(j + 1, gen);
+				if (!set.insert(t).second)
+				{
+					set.insert(j);
+					t = j;
+				}
+				chosen.push_back(t);
+			}
+			std::sort(chosen.begin(), chosen.end());
+		}
+
+		return detail::write_sorted(chosen, n, complement, out);
+	}
+
+	// Maintains a uniform random sample of up to k items from a stream of unknown length.
+	//
+	// Uses Algorithm L, which computes how many items to skip before the next
+	// item is stored, so that items that are skipped do not read any entropy.
+	// The slot to replace is chosen exactly using the converter, and the skip
+	// lengths are computed in double precision from uniform variates read from the converter.
+	// Sampling n items reads O(k log(n/k)) values from the converter.
+	template<typename T>
+	class reservoir_sampler
+	{
+	public:
+		typedef T value_type;
+
+		// Samples up to k items.
+		explicit reservoir_sampler(std::size_t k) : k(k)
+		{
+			items.reserve(k);
+			clear();
+		}
+
+		// Offers the next item in the stream to the sample.
+		// c is an entropy_converter, and gen is a uniform random number generator like std::random_device.
+		// Returns true if the item was stored in the sample.
+		template<typename U, typename Converter, typename Generator>
+		bool push(U &&item, Converter &c, Generator &gen)
+		{
+			if (seen++ != next)
+				return false;
+
+			if (items.size() < k)
+			{
+				items.push_back(std::forward<U>(item));
+				if (items.size() == k)
+				{
+					w = std::exp(std::log(detail::positive_unit_real(c, gen)) / k);
+					advance(c, gen);
+				}
+				else
+					++next;
+			}
+			else
+			{
+				items[(std::size_t)c.convert((typename Converter::result_type)k, gen)] = std::forward<U>(item);
+				w *= std::exp(std::log(detail::positive_unit_real(c, gen)) / k);
+				advance(c, gen);
+			}
+			return true;
+		}
+
+		// The sampled items, in no particular order.
+		const std::vector<T> &sample() const { return items; }
+
+		// The number of items offered so far.
+		std::uint64_t count() const { return seen; }
+
+		// The position in the stream of the next item to be stored.
+		// Items before this can be skipped without calling push().
+		std::uint64_t next_index() const { return next; }
+
+		// Skips to the next item that will be stored, as if push() had been called for each skipped item.
+		void skip_to_next() { seen = next; }
+
+		// Discards the sample.
+		void clear()
+		{
+			items.clear();
+			seen = 0;
+			next = k > 0 ? 0 : std::numeric_limits<std::uint64_t>::max();
+			w = 1.0;
+		}
+
+	private:
+		// Chooses the position of the next item to be stored.
+		template<typename Converter, typename Generator>
+		void advance(Converter &c, Generator &gen)
+		{
+			double skip = std::floor(std::log(detail::positive_unit_real(c, gen)) / std::log1p(-w));
+			const double max_skip = (double)(std::numeric_limits<std::uint64_t>::max() - seen);
+			next = skip < max_skip ? seen + (std::uint64_t)skip : std::numeric_limits<std::uint64_t>::max();
+		}
+
+		std::vector<T> items;
+		std::size_t k;
+		std::uint64_t seen, next;
+		double w;
+	};
+}
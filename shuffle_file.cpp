@@ -0,0 +1,52 @@
+// Shuffles the records of a file, which can be much larger than memory,
+// using entropy from std::random_device.
+//
+// Usage: shuffle_file [-r record_size] [-m memory_mb] [-t temp_directory] input output
+//
+// Records are lines unless a record size in bytes is given.
+
+#include "external_shuffle.hpp"
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+
+static int usage()
+{
+	std::cerr << "Usage: shuffle_file [-r record_size] [-m memory_mb] [-t temp_directory] input output\n";
+	return 1;
+}
+
+int main(int argc, char **argv)
+{
+	econv::shuffle_options options;
+	int i = 1;
+	for (; i + 1 < argc && argv[i][0] == '-'; i += 2)
+	{
+		std::string option = argv[i];
+		if (option == "-r")
+			options.record_size = std::strtoull(argv[i + 1], nullptr, 10);
+		else if (option == "-m")
+			options.memory_limit = std::size_t(std::strtoull(argv[i + 1], nullptr, 10)) << 20;
+		else if (option == "-t")
+			options.temp_directory = argv[i + 1];
+		else
+			return usage();
+	}
+	if (argc - i != 2)
+		return usage();
+
+	try
+	{
+		entropy_converter<std::uint64_t> c;
+		std::random_device d;
+		econv::shuffle_file(argv[i], argv[i + 1], options, c, d);
+	}
+	catch (std::exception &e)
+	{
+		std::cerr << "shuffle_file: " << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}
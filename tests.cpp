@@ -1,6 +1,16 @@
 // Various tests and samples for entropy_converter.
 
 #include "entropy_converter.hpp"
+#include "external_shuffle.hpp"
+#include "sampling.hpp"
+#include "discrete_sampler.hpp"
+#include "distributions.hpp"
+#include "permutation.hpp"
+#include "tokens.hpp"
+#include "transcoder.hpp"
+#include "async_converter.hpp"
+#include "views.hpp"
+#include "io_uring_source.hpp"
 #include <random>
 #include <iostream>
 #include <iomanip>
@@ -8,6 +18,14 @@
 #include <cassert>
 #include <algorithm>
 #include <numeric>
+#include <map>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <functional>
+#if ECONV_IO_URING
+#include <fcntl.h>
+#endif
 
 typedef long double LD;
 
@@ -93,8 +111,8 @@ public:
 	MeasuringRandomDevice() : count(0) { }
 	result_type operator()() { ++count; return d(); }
 	LD entropy() const { return LD(count*sizeof(result_type)*8); }
-	static std::size_t min() { return std::random_device::min(); }
-	static std::size_t max() { return std::random_device::max(); }
+	static constexpr std::size_t min() { return std::random_device::min(); }
+	static constexpr std::size_t max() { return std::random_device::max(); }
 private:
 	std::random_device d;
 	unsigned count;
@@ -294,6 +312,456 @@ void test_entropy_consumption(T target)
 	} while (loss > expected);
 }
 
+// Shuffle a file too large for the given memory, and check the output is a permutation.
+void test_external_shuffle(std::size_t record_size, const char *temp_directory = "")
+{
+	entropy_converter<std::uint64_t> c;
+	std::random_device d;
+	econv::shuffle_options options;
+	options.record_size = record_size;
+	options.temp_directory = temp_directory;
+	options.memory_limit = 100;
+	options.max_buckets = 3;
+
+	const int n = 1000;
+	std::FILE *in = std::tmpfile(), *out = std::tmpfile();
+	for (int i = 0; i < n; ++i)
+	{
+		if (record_size)
+			std::fwrite(&i, sizeof(i), 1, in);
+		else
+			std::fprintf(in, i + 1 < n ? "%d\n" : "%d", i);  // Last line has no newline
+	}
+	std::rewind(in);
+	econv::shuffle_records(in, out, options, c, d);
+	std::rewind(out);
+
+	std::vector<int> records(n);
+	for (int i = 0; i < n; ++i)
+	{
+		auto read = record_size ? std::fread(&records[i], sizeof(int), 1, out) : (std::size_t)std::fscanf(out, "%d\n", &records[i]);
+		assert(read == 1);
+	}
+	int end = std::fgetc(out);
+	assert(end == EOF);
+	std::sort(records.begin(), records.end());
+	for (int i = 0; i < n; ++i)
+		assert(records[i] == i);
+	std::fclose(in);
+	std::fclose(out);
+}
+
+// Ensure that every permutation of a file is equally likely.
+void test_external_shuffle_is_uniform()
+{
+	entropy_converter<std::uint64_t> c;
+	std::random_device d;
+	econv::shuffle_options options;
+	options.memory_limit = 2;  // Force each record into its own bucket
+	options.max_buckets = 2;
+
+	std::vector<unsigned> totals(6);
+	unsigned count = 0;
+	bool valid;
+	do
+	{
+		for (int i = 0; i < 600; ++i, ++count)
+		{
+			std::FILE *in = std::tmpfile(), *out = std::tmpfile();
+			std::fputs("a\nb\nc\n", in);
+			std::rewind(in);
+			econv::shuffle_records(in, out, options, c, d);
+			std::rewind(out);
+			char result[7] = {};
+			auto read = std::fread(result, 1, 6, out);
+			assert(read == 6);
+			std::string permutation = { result[0], result[2], result[4] };
+			const char *permutations[] = { "abc", "acb", "bac", "bca", "cab", "cba" };
+			auto p = std::find(permutations, permutations + 6, permutation) - permutations;
+			assert(p < 6);
+			totals[p]++;
+			std::fclose(in);
+			std::fclose(out);
+		}
+		valid = true;
+		for (auto t : totals)
+			if (t < count / 6 * 9 / 10 || t > count / 6 * 11 / 10)
+				valid = false;
+	} while (!valid);
+}
+
+// Ensure that every combination of k from n is sampled in roughly equal proportion.
+void test_sample_is_uniform(unsigned k, unsigned n)
+{
+	entropy_converter<std::uint32_t> c;
+	std::random_device d;
+	std::map<std::vector<unsigned>, unsigned> totals;
+	unsigned combinations = 1;
+	for (unsigned i = 0; i < k; ++i)
+		combinations = combinations * (n - i) / (i + 1);
+	unsigned count = 0;
+	bool valid;
+	do
+	{
+		for (unsigned i = 0; i < 100 * combinations; ++i, ++count)
+		{
+			std::vector<unsigned> s;
+			econv::sample(c, k, n, std::back_inserter(s), d);
+			assert(s.size() == k);
+			assert(std::is_sorted(s.begin(), s.end()));
+			assert(std::adjacent_find(s.begin(), s.end()) == s.end());
+			assert(s.empty() || s.back() < n);
+			totals[s]++;
+		}
+		valid = totals.size() == combinations;
+		for (auto &t : totals)
+			if (t.second < count / combinations * 9 / 10 || t.second > count / combinations * 11 / 10)
+				valid = false;
+	} while (!valid);
+}
+
+// Ensure that unrank_permutation enumerates permutations in lexicographic order,
+// and that rank_permutation is its inverse.
+template<typename T>
+void test_permutation_rank(unsigned n)
+{
+	std::vector<unsigned> expected(n), p(n);
+	std::iota(expected.begin(), expected.end(), 0);
+	for (T i = 0; i < econv::factorial<T>(n); ++i)
+	{
+		econv::unrank_permutation(i, n, p.begin());
+		assert(p == expected);
+		assert(econv::rank_permutation<T>(p.begin(), p.end()) == i);
+		std::next_permutation(expected.begin(), expected.end());
+	}
+}
+
+// Ensure that large permutations round-trip through rank_permutation.
+void test_permutation_rank_large(unsigned n)
+{
+	entropy_converter<std::uint64_t> c;
+	std::random_device d;
+	std::vector<unsigned> p(n);
+	for (int i = 0; i < 1000; ++i)
+	{
+		auto index = econv::random_permutation_index(c, n, d);
+		econv::unrank_permutation(index, n, p.begin());
+		auto sorted = p;
+		std::sort(sorted.begin(), sorted.end());
+		for (unsigned j = 0; j < n; ++j)
+			assert(sorted[j] == j);
+		assert(econv::rank_permutation<std::uint64_t>(p.begin(), p.end()) == index);
+	}
+	econv::unrank_permutation(econv::factorial<std::uint64_t>(n) - 1, n, p.begin());
+	for (unsigned j = 0; j < n; ++j)
+		assert(p[j] == n - 1 - j);
+}
+
+// Ensure that every permutation of n items is generated in roughly equal proportion.
+void test_permutation_is_uniform(unsigned n, bool in_place)
+{
+	entropy_converter<std::uint32_t> c;
+	std::random_device d;
+	std::map<std::vector<unsigned>, unsigned> totals;
+	auto permutations = econv::factorial<unsigned>(n);
+	unsigned count = 0;
+	bool valid;
+	do
+	{
+		for (unsigned i = 0; i < 100 * permutations; ++i, ++count)
+		{
+			std::vector<unsigned> p(n);
+			if (in_place)
+			{
+				std::iota(p.begin(), p.end(), 0);
+				econv::permute(c, p.begin(), p.end(), d);
+			}
+			else
+				econv::random_permutation(c, n, p.begin(), d);
+			totals[p]++;
+		}
+		valid = totals.size() == permutations;
+		for (auto &t : totals)
+			if (t.second < count / permutations * 9 / 10 || t.second > count / permutations * 11 / 10)
+				valid = false;
+	} while (!valid);
+}
+
+// Ensure that every string of the given length is generated in roughly equal proportion.
+template<typename T>
+void test_random_string_is_uniform(const std::string &alphabet, std::size_t length)
+{
+	entropy_converter<T> c;
+	std::random_device d;
+	std::map<std::string, unsigned> totals;
+	unsigned strings = 1;
+	for (std::size_t i = 0; i < length; ++i)
+		strings *= (unsigned)alphabet.size();
+	unsigned count = 0;
+	bool valid;
+	do
+	{
+		for (unsigned i = 0; i < 100 * strings; ++i, ++count)
+		{
+			auto s = econv::random_string(c, alphabet, length, d);
+			assert(s.size() == length);
+			assert(s.find_first_not_of(alphabet) == std::string::npos);
+			totals[s]++;
+		}
+		valid = totals.size() == strings;
+		for (auto &t : totals)
+			if (t.second < count / strings * 9 / 10 || t.second > count / strings * 11 / 10)
+				valid = false;
+	} while (!valid);
+}
+
+// Measures the entropy read by sample, which should be close to log2 C(n,k).
+void measure_sample(unsigned k, unsigned n, LD max_loss)
+{
+	entropy_converter<std::uint64_t> c;
+	MeasuringRandomDevice d;
+	const int count = 10000;
+	LD output = 0;
+	for (unsigned i = 0; i < k; ++i)
+		output += std::log2(LD(n - i)) - std::log2(LD(i + 1));
+	for (int i = 0; i < count; ++i)
+	{
+		std::vector<unsigned> s;
+		econv::sample(c, k, n, std::back_inserter(s), d);
+		assert(s.size() == k);
+	}
+	LD loss = d.entropy() - std::log2(c.get_buffered_range()) - count * output;
+	assert(loss >= 0);
+	assert(loss < count * max_loss + 64);
+}
+
+// Ensure that each item of a stream is equally likely to be in the sample.
+void test_reservoir_is_uniform(unsigned k, unsigned n)
+{
+	entropy_converter<std::uint64_t> c;
+	MeasuringRandomDevice d;
+	std::vector<unsigned> totals(n);
+	unsigned count = 0;
+	bool valid;
+	do
+	{
+		for (int i = 0; i < 1000; ++i, ++count)
+		{
+			econv::reservoir_sampler<unsigned> r(k);
+			for (unsigned j = 0; j < n; ++j)
+				r.push(j, c, d);
+			assert(r.count() == n);
+			assert(r.sample().size() == std::min(k, n));
+			for (auto x : r.sample())
+				totals[x]++;
+		}
+		valid = true;
+		auto expected = count * std::min(k, n) / n;
+		for (auto t : totals)
+			if (t < expected * 9 / 10 || t > expected * 11 / 10)
+				valid = false;
+	} while (!valid);
+
+	// Skipped items do not read any entropy.
+	econv::reservoir_sampler<unsigned> r(k);
+	LD before = d.entropy();
+	for (unsigned j = 0; j < 1000000; ++j)
+	{
+		if (j < r.next_index())
+			continue;
+		r.skip_to_next();
+		r.push(j, c, d);
+	}
+	assert(r.count() <= 1000000);
+	assert(d.entropy() - before < 1000 * k * std::log2(1000000.0 / k));
+}
+
+// Ensure that a weighted distribution produces outcomes in proportion to their weights.
+// Checks the entropy consumed by the DDG tree is within its bound of H+6 bits.
+void test_discrete_sampler(std::initializer_list<std::uint64_t> weights, econv::discrete_method method)
+{
+	entropy_converter<std::uint64_t> c;
+	MeasuringRandomDevice d;
+	econv::discrete_sampler s(weights, method);
+	std::vector<std::uint64_t> w(weights);
+	auto total = std::accumulate(w.begin(), w.end(), std::uint64_t(0));
+	LD h = 0;
+	for (auto x : w)
+		if (x) h -= LD(x) / total * std::log2(LD(x) / total);
+
+	std::vector<unsigned> totals(w.size());
+	unsigned count = 0;
+	bool valid;
+	do
+	{
+		for (int i = 0; i < 10000; ++i, ++count)
+		{
+			auto x = s(c, d);
+			assert(x < w.size());
+			totals[x]++;
+		}
+		valid = true;
+		for (std::size_t i = 0; i < w.size(); ++i)
+		{
+			auto expected = LD(count) * w[i] / total;
+			if (totals[i] < expected * 0.9 || totals[i] > expected * 1.1)
+				valid = false;
+		}
+	} while (!valid);
+
+	if (method == econv::discrete_method::loaded_dice)
+		assert((d.entropy() - buffered_entropy(c)) / count < h + 6);
+}
+
+// Check that bernoulli(a,b) is true in the right proportion,
+// and reads close to the binary entropy of a/b.
+template<typename T>
+void test_bernoulli(T a, T b)
+{
+	entropy_converter<T> c;
+	MeasuringRandomDevice d;
+	LD p = LD(a) / b;
+	unsigned count = 0, trues = 0;
+	bool valid;
+	do
+	{
+		const int n = 10000;
+		for (int i = 0; i < n; ++i, ++count)
+			trues += c.bernoulli(a, b, d);
+		valid = std::abs(LD(trues) - count * p) <= 0.02 * count;
+	} while (!valid);
+
+	// The information content of the flips that were actually output.
+	LD output = (a == 0 || a == b) ? 0 : -(trues * std::log2(p) + (count - trues) * std::log2(1 - p));
+	auto loss = d.entropy() - buffered_entropy(c) - output;
+	assert(loss < count * (max_entropy_loss(T(2)) + 0.01) + 1);
+
+	std::vector<bool> flips;
+	c.bernoulli_n(a, b, std::back_inserter(flips), 1000, d);
+	assert(flips.size() == 1000);
+	std::bitset<1000> bits;
+	c.bernoulli_n(a, b, bits, d);
+	assert(std::abs(LD(bits.count()) - 1000 * p) < 100);
+}
+
+// Check the range, mean and entropy consumption of uniform_real.
+template<typename T, typename Real>
+void test_uniform_real(Real a, Real b)
+{
+	entropy_converter<T> c;
+	MeasuringRandomDevice d;
+	const int n = 10000;
+	std::vector<Real> values;
+	c.uniform_real_n(a, b, std::back_inserter(values), n, d);
+	LD sum = 0;
+	for (auto x : values)
+	{
+		assert(x >= a && x < b);
+		sum += x;
+	}
+	for (int i = 0; i < n; ++i)
+	{
+		auto x = c.uniform_real(a, b, d);
+		assert(x >= a && x < b);
+		sum += x;
+	}
+	assert(std::abs(sum / (2 * n) - (a + b) / 2) < (b - a) * 0.02);
+
+	// Each number reads D bits of entropy
+	auto bits = d.entropy() - buffered_entropy(c);
+	assert(bits >= 2 * n * std::numeric_limits<Real>::digits * 0.99);
+	assert(bits <= 2 * n * std::numeric_limits<Real>::digits * 1.01 + 64);
+
+	// uniform_real_precise can produce numbers between multiples of 2^-D
+	bool fine = false;
+	for (int i = 0; i < 1000; ++i)
+	{
+		auto x = c.template uniform_real_precise<Real>(d);
+		assert(x >= 0 && x < 1);
+		auto scaled = std::ldexp(x, std::numeric_limits<Real>::digits);
+		fine |= scaled != std::floor(scaled);
+	}
+	assert(fine);
+}
+
+// Check that a sampler produces each outcome with probability pmf[x] (to within 10%),
+// for outcomes with probability above 1%.
+template<typename Sampler>
+void test_distribution(const Sampler &sampler, const std::vector<LD> &pmf)
+{
+	entropy_converter<std::uint64_t> c;
+	std::random_device d;
+	std::vector<unsigned> totals(pmf.size());
+	unsigned count = 0;
+	bool valid;
+	do
+	{
+		for (int i = 0; i < 10000; ++i, ++count)
+		{
+			auto x = sampler(c, d);
+			if (x < pmf.size()) totals[x]++;
+		}
+		valid = true;
+		for (std::size_t x = 0; x < pmf.size(); ++x)
+			if (pmf[x] > 0.01 && (totals[x] < count * pmf[x] * 0.9 || totals[x] > count * pmf[x] * 1.1))
+				valid = false;
+	} while (!valid);
+}
+
+// Check that a sampler reads fewer than max_bits of entropy per sample on average.
+template<typename Sampler>
+void test_distribution_entropy(const Sampler &sampler, LD max_bits)
+{
+	entropy_converter<std::uint64_t> c;
+	MeasuringRandomDevice d;
+	const int n = 10000;
+	for (int i = 0; i < n; ++i)
+		sampler(c, d);
+	assert(d.entropy() - buffered_entropy(c) < n * max_bits);
+}
+
+std::vector<LD> geometric_pmf(LD p, int n)
+{
+	std::vector<LD> pmf;
+	for (int k = 0; k < n; ++k)
+		pmf.push_back(std::pow(1 - p, k) * p);
+	return pmf;
+}
+
+std::vector<LD> binomial_pmf(int n, LD p)
+{
+	std::vector<LD> pmf;
+	for (int k = 0; k <= n; ++k)
+		pmf.push_back(std::exp(std::lgamma(n + 1.0L) - std::lgamma(k + 1.0L) - std::lgamma(n - k + 1.0L)) * std::pow(p, k) * std::pow(1 - p, n - k));
+	return pmf;
+}
+
+std::vector<LD> poisson_pmf(LD lambda, int n)
+{
+	std::vector<LD> pmf;
+	for (int k = 0; k < n; ++k)
+		pmf.push_back(std::exp(-lambda + k * std::log(lambda) - std::lgamma(k + 1.0L)));
+	return pmf;
+}
+
+std::vector<LD> hypergeometric_pmf(int N, int K, int n)
+{
+	auto lc = [](LD n, LD k) { return std::lgamma(n + 1) - std::lgamma(k + 1) - std::lgamma(n - k + 1); };
+	std::vector<LD> pmf;
+	for (int x = 0; x <= n; ++x)
+		pmf.push_back(x > K || n - x > N - K ? 0 : std::exp(lc(K, x) + lc(N - K, n - x) - lc(N, n)));
+	return pmf;
+}
+
+// The entropy of a distribution in bits.
+LD distribution_entropy(const std::vector<LD> &pmf)
+{
+	LD h = 0;
+	for (auto p : pmf)
+		if (p > 0) h -= p * std::log2(p);
+	return h;
+}
+
 template<typename Fn>
 void assert_throws(Fn fn)
 {
@@ -307,6 +775,588 @@ void assert_throws(Fn fn)
 	}
 }
 
+// A generator whose first output is Max+1, which is outside of its range [0,Max],
+// and which throws read_again if it is read again.
+struct read_again {};
+
+template<unsigned Max, bool Trusted>
+struct out_of_range_generator
+{
+	typedef unsigned result_type;
+	static constexpr unsigned min() { return 0; }
+	static constexpr unsigned max() { return Max; }
+	unsigned calls = 0;
+	unsigned operator()()
+	{
+		if (calls++ > 0)
+			throw read_again();
+		return Max + 1;
+	}
+};
+
+template<unsigned Max>
+struct is_trusted_generator<out_of_range_generator<Max, true>> : std::true_type {};
+
+// Whether convert() reads a trusted out_of_range_generator again, instead of rejecting its first output.
+template<unsigned Max>
+bool reads_again()
+{
+	entropy_converter<std::uint64_t> c;
+	out_of_range_generator<Max, true> gen;
+	try
+	{
+		c.convert(6, gen);
+	}
+	catch (const read_again &)
+	{
+		return gen.calls == 2;
+	}
+	return false;
+}
+
+// An error policy that throws its own type, to check which policy reports an error.
+struct policy_error {};
+
+struct throw_policy_error
+{
+	[[noreturn]] static void raise(const char *) { throw policy_error(); }
+};
+
+template<typename Fn>
+void assert_raises(Fn fn)
+{
+	try
+	{
+		fn();
+		assert(!"Expected error not raised");
+	}
+	catch (const policy_error &)
+	{
+	}
+}
+
+// Ensure that a dynamic_discrete_sampler matches its weights as they change.
+void test_dynamic_discrete_sampler()
+{
+	entropy_converter<std::uint64_t> c;
+	std::random_device d;
+	econv::dynamic_discrete_sampler s = { 1, 2, 3, 0, 4 };
+	auto check = [&]()
+	{
+		std::vector<unsigned> totals(s.size());
+		unsigned count = 0;
+		bool valid;
+		do
+		{
+			for (int i = 0; i < 10000; ++i, ++count)
+			{
+				auto x = s(c, d);
+				assert(x < s.size() && s.weight(x) > 0);
+				totals[x]++;
+			}
+			valid = true;
+			for (std::size_t i = 0; i < s.size(); ++i)
+			{
+				auto expected = LD(count) * s.weight(i) / s.total_weight();
+				if (totals[i] < expected * 0.9 || totals[i] > expected * 1.1)
+					valid = false;
+			}
+		} while (!valid);
+	};
+
+	check();
+	s.set_weight(2, 0);
+	s.set_weight(3, 7);
+	assert(s.total_weight() == 14);
+	check();
+	for (std::uint64_t w = 1; w <= 12; ++w)
+		s.push_back(w);
+	s.set_weight(0, 20);
+	assert(s.size() == 17 && s.total_weight() == 111);
+	check();
+
+	econv::dynamic_discrete_sampler empty;
+	assert_throws([&]() { empty(c, d); });
+	empty.push_back(3);
+	assert(empty(c, d) == 0);
+
+	// Totals that do not fit in a 32-bit converter.
+	entropy_converter<std::uint32_t> c32;
+	econv::dynamic_discrete_sampler large = { std::uint64_t(3) << 30, std::uint64_t(3) << 30 };
+	assert_throws([&]() { large(c32, d); });
+	large.set_weight(0, std::uint64_t(1) << 32);
+	large.set_weight(1, std::uint64_t(1) << 32);
+	assert_throws([&]() { large(c32, d); });
+	large.set_weight(0, 1 << 29);
+	large.set_weight(1, 1 << 29);
+	int ones = 0;
+	for (int i = 0; i < 1000; ++i)
+		ones += (int)large(c32, d);
+	assert(ones > 400 && ones < 600);
+}
+
+// Ensure that every combination of outputs from convert_many is equally likely.
+template<typename T>
+void test_convert_many(std::vector<T> targets)
+{
+	entropy_converter<T> c;
+	std::random_device d;
+	std::map<std::vector<T>, unsigned> totals;
+	unsigned combinations = 1;
+	for (auto t : targets)
+		combinations *= (unsigned)t;
+	unsigned count = 0;
+	bool valid;
+	do
+	{
+		for (unsigned i = 0; i < 100 * combinations; ++i, ++count)
+		{
+			std::vector<T> out;
+			c.convert_many(targets.begin(), targets.end(), std::back_inserter(out), d);
+			assert(out.size() == targets.size());
+			for (std::size_t j = 0; j < out.size(); ++j)
+				assert(out[j] < targets[j]);
+			totals[out]++;
+		}
+		valid = totals.size() == combinations;
+		for (auto &t : totals)
+			if (t.second < count / combinations * 9 / 10 || t.second > count / combinations * 11 / 10)
+				valid = false;
+	} while (!valid);
+}
+
+// Ensure that consecutive pairs of outputs from convert_n are equally likely.
+template<typename T>
+void test_convert_n(T target)
+{
+	entropy_converter<T> c;
+	std::random_device d;
+	std::map<std::pair<T, T>, unsigned> totals;
+	unsigned pairs = (unsigned)(target * target);
+	unsigned count = 0;
+	bool valid;
+	do
+	{
+		std::vector<T> out(2 * 100 * pairs + 1);
+		c.convert_n(target, out.begin(), out.size(), d);
+		for (std::size_t i = 0; i + 1 < out.size(); i += 2, ++count)
+		{
+			assert(out[i] < target && out[i + 1] < target);
+			totals[std::make_pair(out[i], out[i + 1])]++;
+		}
+		assert(out.back() < target);
+		valid = totals.size() == pairs;
+		for (auto &t : totals)
+			if (t.second < count / pairs * 9 / 10 || t.second > count / pairs * 11 / 10)
+				valid = false;
+	} while (!valid);
+}
+
+// Ensure that transcoded digits are uniform, and use nearly all of the input entropy.
+template<typename T>
+void test_transcoder(unsigned from, unsigned to)
+{
+	std::random_device d;
+	entropy_converter<T> c;
+	std::vector<unsigned> input(100000), output;
+	for (auto &x : input)
+		x = c.convert(from, d);
+	econv::transcode_digits<T>(input.begin(), input.end(), from, to, std::back_inserter(output));
+
+	LD inputEntropy = input.size() * std::log2(LD(from)), outputEntropy = output.size() * std::log2(LD(to));
+	assert(outputEntropy <= inputEntropy);
+	assert(inputEntropy - outputEntropy < 2 * std::numeric_limits<T>::digits + 100000 * max_entropy_loss<T>(to, from));
+
+	std::vector<unsigned> totals(to);
+	for (auto x : output)
+	{
+		assert(x < to);
+		totals[x]++;
+	}
+	if (to <= 16)
+		for (auto t : totals)
+			assert(t > output.size() / to * 9 / 10 && t < output.size() / to * 11 / 10);
+}
+
+// Ensure that the transcoder iterates and handles invalid input.
+void test_transcoder_iterator()
+{
+	// Bits to bits keeps every bit.
+	std::vector<int> bits = { 1, 0, 1, 1, 0, 0, 0, 1, 1, 1 };
+	auto t = econv::make_digit_transcoder(bits.begin(), bits.end(), 2, 2);
+	std::size_t count = 0, ones = 0;
+	for (auto b : t)
+		++count, ones += b;
+	assert(count == bits.size() && ones == 6);
+
+	std::vector<int> empty;
+	auto e = econv::make_digit_transcoder(empty.begin(), empty.end(), 6, 10);
+	assert(e.begin() == e.end());
+
+	std::vector<int> invalid = { 1, 2, 6 };
+	auto i = econv::make_digit_transcoder(invalid.begin(), invalid.end(), 6, 2);
+	assert_throws([&]() { std::vector<unsigned> out; i.read(std::back_inserter(out)); });
+	assert_throws([&]() { econv::make_digit_transcoder(empty.begin(), empty.end(), 1, 10); });
+}
+
+// Ensure that tokens are separated by terminators, and cover the alphabet.
+void test_fill_tokens()
+{
+	entropy_converter<std::uint64_t> c;
+	std::random_device d;
+	std::vector<char> buffer(100 * 9 + 1, '*');
+	auto end = econv::fill_tokens(c, econv::base62_alphabet, 8, 100, &buffer[0], d);
+	assert(end == &buffer[0] + 100 * 9);
+	assert(buffer.back() == '*');
+	std::map<char, unsigned> totals;
+	for (int i = 0; i < 100; ++i)
+	{
+		assert(std::strlen(&buffer[i * 9]) == 8);
+		for (int j = 0; j < 8; ++j)
+			totals[buffer[i * 9 + j]]++;
+	}
+	assert(totals.size() > 50);
+
+	auto s = econv::random_string(c, "x", 5, d);
+	assert(s == "xxxxx");
+	assert(econv::random_string(c, "ab", 0, d).empty());
+	assert_throws([&]() { econv::random_string(c, "", 5, d); });
+}
+
+// A generator that returns the values in a queue, and would block when the queue is empty.
+class QueueGenerator
+{
+public:
+	typedef unsigned result_type;
+
+	QueueGenerator(unsigned min, unsigned max) : lo(min), hi(max) { }
+	unsigned min() const { return lo; }
+	unsigned max() const { return hi; }
+
+	bool try_generate(unsigned & x)
+	{
+		if (queue.empty())
+			return false;
+		x = queue.front();
+		queue.pop_front();
+		return true;
+	}
+
+	std::deque<unsigned> queue;
+private:
+	unsigned lo, hi;
+};
+
+void test_try_convert_nonblocking(unsigned min, unsigned max, std::uint32_t target = 6)
+{
+	entropy_converter<std::uint32_t> c;
+	QueueGenerator gen(min, max);
+	std::uint32_t r = 99;
+	assert(c.try_convert(target, r, gen) == convert_status::would_block);
+	assert(r == 99 && c.get_buffered_range() == 1);
+
+	std::random_device d;
+	std::uniform_int_distribution<unsigned> input(min, max);
+	const int n = 10000 * target;
+	std::vector<int> counts(target);
+	int inputs = 0;
+	for (int i = 0; i < n;)
+	{
+		auto status = c.try_convert(target, r, gen);
+		if (status == convert_status::would_block)
+		{
+			assert(gen.queue.empty());
+			gen.queue.push_back(input(d));
+			++inputs;
+		}
+		else
+		{
+			assert(status == convert_status::ok);
+			++counts[r];
+			++i;
+		}
+	}
+	for (int x : counts)
+		assert(x > n / target * 0.9 && x < n / target * 1.1);
+
+	// Entropy is buffered while blocked, not lost.
+	LD input_entropy = inputs * std::log2(LD(max - min + 1)), output_entropy = n * std::log2(LD(target));
+	assert(input_entropy < output_entropy * 1.1 + 64);
+}
+
+#if defined(__cpp_impl_coroutine)
+// A QueueGenerator that calls back when a value is pushed.
+class AsyncQueue : public QueueGenerator
+{
+public:
+	AsyncQueue(unsigned min, unsigned max) : QueueGenerator(min, max) { }
+
+	template<typename Fn>
+	void when_ready(Fn fn) { waiting.push_back(fn); }
+
+	void push(unsigned x)
+	{
+		queue.push_back(x);
+		auto ready = std::move(waiting);
+		waiting.clear();
+		for (auto &fn : ready)
+			fn();
+	}
+
+	std::vector<std::function<void()>> waiting;
+};
+
+// A coroutine that starts immediately, and is not awaited.
+struct detached_task
+{
+	struct promise_type
+	{
+		detached_task get_return_object() { return {}; }
+		std::suspend_never initial_suspend() { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() { }
+		void unhandled_exception() { std::terminate(); }
+	};
+};
+
+template<typename Source>
+detached_task roll_dice(econv::async_entropy_converter<Source> & c, std::vector<int> & rolls, int n)
+{
+	for (int i = 0; i < n; ++i)
+		rolls.push_back((int)co_await c.convert_async(1, 6));
+}
+
+void test_async_converter()
+{
+	AsyncQueue source(0, 255);
+	econv::async_entropy_converter<AsyncQueue> c(source);
+	std::vector<int> rolls;
+	const int n = 60000;
+
+	// The coroutine suspends until the first input.
+	roll_dice(c, rolls, n);
+	assert(rolls.empty() && source.waiting.size() == 1);
+
+	std::random_device d;
+	while ((int)rolls.size() < n)
+	{
+		assert(source.waiting.size() == 1);
+		source.push(d() & 255);
+	}
+	assert(source.waiting.empty());
+
+	int counts[7] = {};
+	for (int r : rolls)
+		++counts[r];
+	assert(counts[0] == 0);
+	for (int i = 1; i <= 6; ++i)
+		assert(counts[i] > n / 6 * 0.9 && counts[i] < n / 6 * 1.1);
+}
+#endif
+
+#if defined(__cpp_lib_ranges)
+void test_uniform_view()
+{
+	entropy_converter<std::uint64_t> c;
+	std::random_device d;
+	auto rolls = econv::views::uniform(c, 1, 6, d);
+	static_assert(std::ranges::view<decltype(rolls)>);
+	static_assert(std::ranges::input_range<decltype(rolls)>);
+
+	const int n = 60000;
+	std::vector<int> v;
+	std::ranges::copy(rolls | std::views::take(n), std::back_inserter(v));
+	assert(v.size() == n);
+	int counts[7] = {};
+	for (int r : v)
+		++counts[r];
+	assert(counts[0] == 0);
+	for (int i = 1; i <= 6; ++i)
+		assert(counts[i] > n / 6 * 0.9 && counts[i] < n / 6 * 1.1);
+
+	// Skipped elements are not converted.
+	MeasuringRandomDevice m;
+	auto it = econv::views::uniform(c, 0, 1, m).begin();
+	for (int i = 0; i < 1000; ++i)
+		++it;
+	assert(m.entropy() == 0);
+
+	auto doubled = econv::views::uniform(c, 0u, 9u, d) | std::views::transform([](unsigned x) { return 2 * x; }) | std::views::take(10);
+	for (unsigned x : doubled)
+		assert(x % 2 == 0 && x < 20);
+}
+#endif
+
+#if ECONV_IO_URING
+// Whether reading the next value from gen throws std::runtime_error.
+template<typename Generator>
+bool read_fails(Generator & gen)
+{
+	try
+	{
+		gen();
+		return false;
+	}
+	catch (std::runtime_error &)
+	{
+		return true;
+	}
+}
+
+void test_io_uring_source()
+{
+	// A file of known bytes is read in order.
+	std::FILE *file = std::tmpfile();
+	const int n = 100000;
+	for (int i = 0; i < n; ++i)
+		std::fputc(i * 7 & 255, file);
+	std::fflush(file);
+	std::rewind(file);
+	std::unique_ptr<econv::io_uring_entropy_source<unsigned char>> bytes;
+	try
+	{
+		bytes.reset(new econv::io_uring_entropy_source<unsigned char>(fileno(file), 4096, 4));
+	}
+	catch (std::runtime_error &e)
+	{
+		// io_uring may be disabled, for example in a container.
+		std::cout << "Skipping io_uring test: " << e.what() << std::endl;
+		std::fclose(file);
+		return;
+	}
+	for (int i = 0; i < n; ++i)
+		assert((*bytes)() == (i * 7 & 255));
+	assert(read_fails(*bytes));
+	bytes.reset();
+
+	// Words can span reads, and are read without waiting once the reads have completed.
+	std::rewind(file);
+	{
+		econv::io_uring_entropy_source<std::uint32_t> words(fileno(file), 4099, 3);
+		std::uint32_t w;
+		for (int i = 0; i < n / 4; ++i)
+		{
+			if (!words.try_generate(w))
+				w = words();
+			assert(w == ((i * 28 & 255) | ((i * 28 + 7) & 255) << 8 | ((i * 28 + 14) & 255) << 16 | (std::uint32_t)((i * 28 + 21) & 255) << 24));
+		}
+	}
+	std::fclose(file);
+
+	// Pipes are read in the order that the reads complete.
+	int fds[2];
+	int result = pipe(fds);
+	assert(result == 0);
+	unsigned char data[1000];
+	int sum = 0;
+	for (int i = 0; i < 1000; ++i)
+		sum += data[i] = (unsigned char)i;
+	auto written = write(fds[1], data, sizeof(data));
+	assert(written == sizeof(data));
+	close(fds[1]);
+	{
+		econv::io_uring_entropy_source<unsigned char> pipe_source(fds[0], 256, 4);
+		for (int i = 0; i < 1000; ++i)
+			sum -= pipe_source();
+		assert(sum == 0);
+		assert(read_fails(pipe_source));
+	}
+	close(fds[0]);
+
+	// Reads from an idle pipe are cancelled when the source is destroyed.
+	result = pipe(fds);
+	assert(result == 0);
+	written = write(fds[1], data, 32);
+	assert(written == 32);
+	{
+		econv::io_uring_entropy_source<unsigned char> idle(fds[0], 16, 4);
+		assert(idle() == 0);
+	}
+	close(fds[0]);
+	close(fds[1]);
+
+#if defined(__cpp_impl_coroutine)
+	// Coroutines waiting for entropy are resumed by process_completions() once a read completes.
+	result = pipe(fds);
+	assert(result == 0);
+	{
+		econv::io_uring_entropy_source<> source(fds[0], 256, 2);
+		econv::async_entropy_converter<econv::io_uring_entropy_source<>> c(source);
+		std::vector<int> rolls;
+		const int rolls_n = 60000;
+		roll_dice(c, rolls, rolls_n);
+		assert(rolls.empty());
+		std::random_device d;
+		while ((int)rolls.size() < rolls_n)
+		{
+			for (auto &x : data)
+				x = (unsigned char)d();
+			written = write(fds[1], data, sizeof(data));
+			assert(written == sizeof(data));
+			source.process_completions();
+		}
+		int counts[7] = {};
+		for (int r : rolls)
+			++counts[r];
+		assert(counts[0] == 0);
+		for (int i = 1; i <= 6; ++i)
+			assert(counts[i] > rolls_n / 6 * 0.9 && counts[i] < rolls_n / 6 * 1.1);
+	}
+	close(fds[0]);
+	close(fds[1]);
+
+	// If a waiting coroutine fails at the end of the input, the others keep waiting.
+	result = pipe(fds);
+	assert(result == 0);
+	{
+		econv::io_uring_entropy_source<> source(fds[0], 256, 2);
+		econv::async_entropy_converter<econv::io_uring_entropy_source<>> c(source);
+		std::vector<int> rolls;
+		roll_dice(c, rolls, 1);
+		roll_dice(c, rolls, 1);
+		close(fds[1]);
+		bool failed = false;
+		try
+		{
+			source.process_completions();
+		}
+		catch (std::runtime_error &)
+		{
+			failed = true;
+		}
+		assert(failed);
+		failed = false;
+		try
+		{
+			source.process_completions();
+		}
+		catch (std::runtime_error &)
+		{
+			failed = true;
+		}
+		assert(failed);
+		assert(source.process_completions() == 0 && rolls.empty());
+	}
+	close(fds[0]);
+#endif
+
+	// Conversions from a device.
+	int fd = open("/dev/urandom", O_RDONLY);
+	if (fd >= 0)
+	{
+		econv::io_uring_entropy_source<> source(fd);
+		entropy_converter<std::uint64_t> c;
+		const int rolls = 60000;
+		int counts[6] = {};
+		for (int i = 0; i < rolls; ++i)
+			++counts[c.convert(6, source)];
+		for (int x : counts)
+			assert(x > rolls / 6 * 0.9 && x < rolls / 6 * 1.1);
+		close(fd);
+	}
+}
+#endif
+
 void tests()
 {
 	std::cout << "\nRunning tests\n";
@@ -346,6 +1396,134 @@ void tests()
 	assert_throws([&]() { c16.convert(1, 100, 1, 1, gen1); });
 	assert_throws([&]() { c16.convert(1, 100, 2, 1, gen1); });
 
+	// Status codes instead of errors
+	{
+		std::uint16_t r = 7;
+		assert(c16.try_convert(0, r, d) == convert_status::invalid_output_range);
+		assert(c16.try_convert(0x8000, r, d) == convert_status::output_range_too_large);
+		assert(r == 7);
+		struct { unsigned min() const { return 1; } unsigned max() const { return 1; } unsigned operator()() { return 1; } } gen0;
+		assert(c16.try_convert(6, r, gen0) == convert_status::invalid_input_range);
+		assert(c16.try_convert(6, r, d) == convert_status::ok);
+		assert(r < 6);
+	}
+
+	// Other error policies
+	{
+		entropy_converter<std::uint32_t, unsigned, abort_on_error> ca;
+		entropy_converter<std::uint64_t, unsigned, assume_no_error> cu;
+		for (int i = 0; i < 1000; ++i)
+		{
+			assert(ca.convert(6, d) < 6);
+			assert(cu.convert(52, d) < 52);
+		}
+	}
+
+	// Smaller buffers
+	{
+		entropy_converter<std::uint64_t, unsigned, default_error_policy, 0x100000> small;
+		for (int i = 0; i < 1000; ++i)
+			assert(small.convert(6, d) < 6);
+		small.convert(0x80000, d);
+		assert_throws([&]() { small.convert(0x80001, d); });
+	}
+
+	// Lazy refills
+	{
+		MeasuringRandomDevice m1, m2;
+		entropy_converter<std::uint64_t> eager;
+		entropy_converter<std::uint64_t, unsigned, default_error_policy, ~std::uint64_t(0), lazy_refill<8>> lazy;
+		eager.convert(3, m1);
+		lazy.convert(3, m2);
+		assert(m1.entropy() == 64 && m2.entropy() == 32);
+
+		int counts[6] = {};
+		const int n = 60000;
+		for (int i = 0; i < n; ++i)
+		{
+			++counts[lazy.convert(6, d)];
+			assert(lazy.convert(1000000, d) < 1000000);
+			lazy.bernoulli(1, 3, d);
+		}
+		for (int c : counts)
+			assert(c > n / 6 * 0.9 && c < n / 6 * 1.1);
+	}
+
+	// Prefilling
+	{
+		MeasuringRandomDevice m;
+		entropy_converter<std::uint64_t> c;
+		assert(c.available_bits() == 0);
+		c.prefill(m, 20);
+		assert(c.available_bits() >= 20 && m.entropy() == 32);
+		c.reserve(m);
+		assert(c.available_bits() >= 64);
+		auto before = m.entropy();
+		c.reserve(m);
+		c.prefill(m, 64);
+		assert(m.entropy() == before);
+		assert(c.available_bits() == (int)std::log2(c.get_buffered_range()));
+
+		entropy_converter<std::uint32_t> g;
+		g.reserve(d);
+		g.prefill(d, 1000);
+		assert(g.available_bits() >= 31);
+
+		// A converter that has already been used has a partly used bit buffer.
+		entropy_converter<std::uint64_t> used;
+		used.convert(2, d);
+		assert(used.available_bits() == 31);
+		used.prefill(d, 40);
+		assert(used.available_bits() >= 40);
+		used.convert(6, d);
+		used.prefill(d, 100);
+		assert(used.available_bits() >= 63);
+	}
+
+	test_try_convert_nonblocking(0, 255);
+	test_try_convert_nonblocking(1, 6);
+	test_try_convert_nonblocking(0, 1);
+	// Powers of 2 and even targets are read from the bit buffer.
+	test_try_convert_nonblocking(0, 255, 64);
+	test_try_convert_nonblocking(0, 1, 48);
+
+#if defined(__cpp_impl_coroutine)
+	test_async_converter();
+#endif
+
+#if defined(__cpp_lib_ranges)
+	test_uniform_view();
+#endif
+
+#if ECONV_IO_URING
+	test_io_uring_source();
+#endif
+
+	// Trusted generators
+	static_assert(is_trusted_generator<std::mt19937_64>::value, "Standard engines are trusted");
+	static_assert(is_trusted_generator<std::minstd_rand>::value, "Standard engines are trusted");
+	static_assert(!is_trusted_generator<std::random_device>::value, "Devices are checked");
+	{
+		std::minstd_rand e;
+		std::mt19937 m;
+		for (int i = 0; i < 1000; ++i)
+		{
+			assert(c64.convert(6, e) < 6);
+			assert(c64.convert(6, m) < 6);
+		}
+	}
+	{
+		// Out-of-range outputs are only rejected if the generator is not trusted.
+		entropy_converter<std::uint64_t> c1, c2;
+		out_of_range_generator<5, false> general;
+		out_of_range_generator<3, false> binary;
+		assert_throws([&]() { c1.convert(6, general); });
+		assert_throws([&]() { c2.convert(6, binary); });
+		assert(general.calls == 1 && binary.calls == 1);
+		assert(reads_again<5>());
+		assert(reads_again<3>());
+	}
+
 	// Test the quality of the output
 
 	for (int i = 1; i < 100; ++i)
@@ -358,6 +1536,161 @@ void tests()
 		test_entropy_consumption<std::uint64_t>(i);
 	}
 
+	test_external_shuffle(0);
+	test_external_shuffle(sizeof(int));
+	test_external_shuffle(0, ".");
+	test_external_shuffle_is_uniform();
+
+	test_sample_is_uniform(0, 5);
+	test_sample_is_uniform(2, 4);
+	test_sample_is_uniform(3, 4);
+	test_sample_is_uniform(2, 20);
+	test_sample_is_uniform(18, 20);
+	measure_sample(5, 52, 0.01);
+	measure_sample(47, 52, 0.01);
+	measure_sample(10, 20, 0.01);
+	assert_throws([&]() { std::vector<unsigned> s; econv::sample(c32, 5u, 4u, std::back_inserter(s), d); });
+
+	for (unsigned n = 0; n <= 8; ++n)
+		test_permutation_rank<std::uint32_t>(n);
+	test_permutation_rank_large(16);
+	test_permutation_rank_large(20);
+	test_permutation_is_uniform(4, false);
+	test_permutation_is_uniform(4, true);
+	test_permutation_is_uniform(1, true);
+	assert(econv::max_permutation_size<std::uint64_t>() == 20);
+	assert(econv::max_permutation_size<std::uint16_t>() == 8);
+	assert_throws([&]() { econv::factorial<std::uint64_t>(21); });
+	assert_throws([&]() { std::vector<unsigned> p = { 0, 2, 2 }; econv::rank_permutation<std::uint64_t>(p.begin(), p.end()); });
+	assert_throws([&]() { std::vector<unsigned> p(4); econv::unrank_permutation(24u, 4, p.begin()); });
+
+	test_random_string_is_uniform<std::uint16_t>("abc", 3);
+	test_random_string_is_uniform<std::uint64_t>("abc", 3);
+	test_random_string_is_uniform<std::uint64_t>("0123456789", 2);
+	test_fill_tokens();
+
+	test_convert_many<std::uint16_t>({ 6, 6, 6, 2 });
+	test_convert_many<std::uint32_t>({ 3, 1, 4, 5 });
+	test_convert_many<std::uint64_t>({ 6, 6, 20 });
+	test_convert_many<std::uint64_t>({});
+	{
+		unsigned rolls[4];
+		c64.convert_many({ 6, 6, 6, 20 }, rolls, d);
+		assert(rolls[0] < 6 && rolls[1] < 6 && rolls[2] < 6 && rolls[3] < 20);
+		std::vector<std::uint64_t> big = { 1000000, 1000000, 1000000, 0x4000000000000000 }, out;
+		c64.convert_many(big.begin(), big.end(), std::back_inserter(out), d);
+		assert(out.size() == 4);
+		assert_throws([&]() { c64.convert_many({ 6, 0 }, rolls, d); });
+	}
+
+	for (int t : { 1, 2, 3, 6, 10, 17 })
+	{
+		test_convert_n<std::uint16_t>(t);
+		test_convert_n<std::uint32_t>(t);
+		test_convert_n<std::uint64_t>(t);
+#ifdef __SIZEOF_INT128__
+		// 128-bit blocks are split without truncating t^k to 64 bits.
+		__extension__ typedef unsigned __int128 u128;
+		test_convert_n<u128>(t);
+#endif
+	}
+	{
+		std::vector<std::uint64_t> out(100);
+		c64.convert_n(0x10000000000, out.begin(), out.size(), d);
+		assert(*std::max_element(out.begin(), out.end()) < 0x10000000000);
+		assert_throws([&]() { c64.convert_n(0, out.begin(), out.size(), d); });
+	}
+
+	test_transcoder<std::uint32_t>(6, 2);
+	test_transcoder<std::uint64_t>(6, 2);
+	test_transcoder<std::uint64_t>(10, 9);
+	test_transcoder<std::uint64_t>(2, 256);
+	test_transcoder<std::uint64_t>(16, 10);
+	test_transcoder_iterator();
+
+	test_reservoir_is_uniform(1, 5);
+	test_reservoir_is_uniform(3, 10);
+	test_reservoir_is_uniform(10, 5);
+
+	for (auto method : { econv::discrete_method::alias, econv::discrete_method::loaded_dice })
+	{
+		test_discrete_sampler({ 1 }, method);
+		test_discrete_sampler({ 0, 5, 0 }, method);
+		test_discrete_sampler({ 1, 2, 3, 0, 4 }, method);
+		test_discrete_sampler({ 6, 6, 6, 6 }, method);
+		test_discrete_sampler({ 1000, 100, 8900 }, method);
+		assert_throws([&]() { econv::discrete_sampler({ 0, 0 }, method); });
+	}
+	{
+		// The total weight does not fit in a 32-bit converter.
+		econv::discrete_sampler alias({ std::uint64_t(1) << 32, 1 }, econv::discrete_method::alias);
+		assert_throws([&]() { alias(c32, d); });
+		econv::discrete_sampler dice({ std::uint64_t(1) << 32, 1 }, econv::discrete_method::loaded_dice);
+		for (int i = 0; i < 1000; ++i)
+			assert(dice(c32, d) == 0);
+	}
+	test_dynamic_discrete_sampler();
+
+	for (auto ab : { std::make_pair(0, 1), std::make_pair(1, 1), std::make_pair(1, 2), std::make_pair(1, 3), std::make_pair(2, 3), std::make_pair(1, 1000), std::make_pair(999, 1000) })
+	{
+		test_bernoulli<std::uint16_t>(ab.first, ab.second);
+		test_bernoulli<std::uint32_t>(ab.first, ab.second);
+		test_bernoulli<std::uint64_t>(ab.first, ab.second);
+#ifdef __SIZEOF_INT128__
+		__extension__ typedef unsigned __int128 u128;
+		test_bernoulli<u128>(ab.first, ab.second);
+#endif
+	}
+	test_bernoulli<std::uint64_t>(0x7fffffffffffffff, 0xffffffffffffffff);
+	assert_throws([&]() { c32.bernoulli(2, 1, d); });
+	assert_throws([&]() { c32.bernoulli(0, 0, d); });
+
+	test_uniform_real<std::uint16_t>(0.0, 1.0);
+	test_uniform_real<std::uint32_t>(-3.0f, 5.0f);
+	test_uniform_real<std::uint64_t>(0.0, 1.0);
+	test_uniform_real<std::uint64_t>(1e10L, 1e11L);
+	assert_throws([&]() { c32.uniform_real(1.0, 1.0, d); });
+
+	test_distribution(econv::geometric_sampler(1, 3), geometric_pmf(1.0L / 3, 20));
+	test_distribution(econv::geometric_sampler(1, 1), geometric_pmf(1, 5));
+	test_distribution(econv::binomial_sampler(10, 1, 3), binomial_pmf(10, 1.0L / 3));
+	test_distribution(econv::binomial_sampler(100, 1, 2), binomial_pmf(100, 0.5L));
+	test_distribution(econv::binomial_sampler(50, 999, 1000), binomial_pmf(50, 0.999L));
+	test_distribution(econv::binomial_sampler(7, 0, 1), binomial_pmf(7, 0));
+	test_distribution(econv::binomial_sampler(1000, 1, 10), binomial_pmf(1000, 0.1L));
+	test_distribution(econv::binomial_sampler(1000, 3, 6), binomial_pmf(1000, 0.5L));
+	test_distribution(econv::binomial_sampler(3000, 1, 3), binomial_pmf(3000, 1.0L / 3));
+	test_distribution_entropy(econv::binomial_sampler(1000, 1, 10), 5.3 + 6);
+	test_distribution(econv::poisson_sampler(1, 1), poisson_pmf(1, 20));
+	test_distribution(econv::poisson_sampler(5, 2), poisson_pmf(2.5L, 30));
+	test_distribution(econv::poisson_sampler(1, 10), poisson_pmf(0.1L, 10));
+	test_distribution(econv::hypergeometric_sampler(52, 13, 5), hypergeometric_pmf(52, 13, 5));
+	test_distribution(econv::hypergeometric_sampler(10, 10, 4), hypergeometric_pmf(10, 10, 4));
+	test_distribution(econv::hypergeometric_sampler(1000, 300, 40), hypergeometric_pmf(1000, 300, 40));
+	test_distribution(econv::hypergeometric_sampler(1000, 300, 980), hypergeometric_pmf(1000, 300, 980));
+	assert_throws([&]() { econv::geometric_sampler(0, 1); });
+	assert_throws([&]() { econv::binomial_sampler(10, 3, 2); });
+	assert_throws([&]() { econv::hypergeometric_sampler(10, 11, 2); });
+
+	// The other headers report errors using the converter's error policy, or the sampler's.
+	{
+		entropy_converter<std::uint32_t, unsigned, throw_policy_error> cp;
+		std::vector<unsigned> s;
+		unsigned items[] = { 0, 0 };
+		assert_raises([&]() { econv::sample(cp, 5u, 4u, std::back_inserter(s), d); });
+		assert_raises([&]() { econv::random_string(cp, "", 4, d); });
+		assert_raises([&]() { econv::random_permutation_index(cp, 13, d); });
+		assert_raises([&]() { econv::factorial<std::uint32_t, throw_policy_error>(13); });
+		assert_raises([&]() { econv::rank_permutation<std::uint32_t, throw_policy_error>(items, items + 2); });
+		assert_raises([&]() { econv::discrete_sampler({ 1, 0xffffffff })(cp, d); });
+		assert_raises([&]() { econv::basic_discrete_sampler<throw_policy_error>({ 0, 0 }); });
+		assert_raises([&]() { econv::basic_dynamic_discrete_sampler<throw_policy_error>()(cp, d); });
+		assert_raises([&]() { econv::basic_geometric_sampler<throw_policy_error>(0, 1); });
+		assert_raises([&]() { econv::basic_binomial_sampler<throw_policy_error>(10, 3, 2); });
+		assert_raises([&]() { econv::basic_poisson_sampler<throw_policy_error>(1, 0); });
+		assert_raises([&]() { econv::basic_hypergeometric_sampler<throw_policy_error>(10, 11, 2); });
+	}
+
 	std::cout << "Tests passed\n";
 }
 
@@ -368,6 +1701,63 @@ void measure_conversions(int from, int to)
 	measure_conversion<std::uint64_t>(from, to);
 }
 
+// Measure the time and entropy used by a sampler, compared with the entropy of its distribution.
+template<typename Sampler>
+void measure_distribution(const char *name, const Sampler &sampler, const std::vector<LD> &pmf)
+{
+	entropy_converter<std::uint64_t> c;
+	MeasuringRandomDevice d;
+	const int n = 100000;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < n; ++i)
+		sampler(c, d);
+	std::chrono::duration<double, std::nano> time = std::chrono::steady_clock::now() - start;
+
+	std::cout << std::setprecision(6);
+	std::cout
+		<< "| " << name
+		<< " | " << time.count() / n
+		<< " | " << (d.entropy() - buffered_entropy(c)) / n
+		<< " | " << distribution_entropy(pmf)
+		<< " |\n";
+}
+
+// Measure the time and entropy used by std:: distributions for comparison.
+template<typename Distribution>
+void measure_std_distribution(const char *name, Distribution dist, const std::vector<LD> &pmf)
+{
+	MeasuringRandomDevice d;
+	const int n = 100000;
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < n; ++i)
+		dist(d);
+	std::chrono::duration<double, std::nano> time = std::chrono::steady_clock::now() - start;
+
+	std::cout << std::setprecision(6);
+	std::cout
+		<< "| " << name
+		<< " | " << time.count() / n
+		<< " | " << d.entropy() / n
+		<< " | " << distribution_entropy(pmf)
+		<< " |\n";
+}
+
+void measure_distributions()
+{
+	std::cout << "\n| Distribution | Time (ns/sample) | Input entropy (bits/sample) | Output entropy (bits/sample) |\n";
+	std::cout << "|--------------|-----------------:|----------------------------:|-----------------------------:|\n";
+	measure_distribution("Geometric(1/3)", econv::geometric_sampler(1, 3), geometric_pmf(1.0L / 3, 200));
+	measure_std_distribution("std::geometric_distribution(1/3)", std::geometric_distribution<>(1.0 / 3), geometric_pmf(1.0L / 3, 200));
+	measure_distribution("Binomial(20, 1/2)", econv::binomial_sampler(20, 1, 2), binomial_pmf(20, 0.5L));
+	measure_std_distribution("std::binomial_distribution(20, 1/2)", std::binomial_distribution<>(20, 0.5), binomial_pmf(20, 0.5L));
+	measure_distribution("Binomial(1000, 1/10)", econv::binomial_sampler(1000, 1, 10), binomial_pmf(1000, 0.1L));
+	measure_std_distribution("std::binomial_distribution(1000, 1/10)", std::binomial_distribution<>(1000, 0.1), binomial_pmf(1000, 0.1L));
+	measure_distribution("Poisson(5/2)", econv::poisson_sampler(5, 2), poisson_pmf(2.5L, 100));
+	measure_std_distribution("std::poisson_distribution(5/2)", std::poisson_distribution<>(2.5), poisson_pmf(2.5L, 100));
+	measure_distribution("Hypergeometric(52, 13, 5)", econv::hypergeometric_sampler(52, 13, 5), hypergeometric_pmf(52, 13, 5));
+	measure_distribution("Hypergeometric(1000, 300, 40)", econv::hypergeometric_sampler(1000, 300, 40), hypergeometric_pmf(1000, 300, 40));
+}
+
 void measurements()
 {
 #ifndef __clang__  // Not working on clang due to bug in library
@@ -401,6 +1791,8 @@ void measurements()
 	measure_expected_entropy<std::uint16_t>();
 	measure_expected_entropy<std::uint32_t>();
 	measure_expected_entropy<std::uint64_t>();
+
+	measure_distributions();
 }
 
 int main()
@@ -0,0 +1,100 @@
+// Random strings over arbitrary alphabets using entropy_converter,
+// for passwords, invite codes and IDs.
+//
+// Example:
+//
+// entropy_converter<std::uint64_t> c;
+// std::random_device d;
+// std::cout << econv::random_string(c, econv::base62_alphabet, 22, d) << std::endl;
+//
+// char codes[1000 * 9];
+// econv::fill_tokens(c, "ABCDEFGHJKLMNPQRSTUVWXYZ23456789", 8, 1000, codes, d);
+
+#pragma once
+
+#include "entropy_converter.hpp"
+#include <cstring>
+#include <limits>
+#include <string>
+
+namespace econv
+{
+	const char decimal_alphabet[] = "0123456789";
+	const char hex_alphabet[] = "0123456789abcdef";
+	const char base62_alphabet[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+
+	namespace detail
+	{
+		// Writes n random characters from 'alphabet' to out.
+		// Several characters are read with each call to convert(size^k), where size^k fits
+		// in half of result_type to keep conversion efficient, and then split into base-size digits.
+		template<typename Converter, typename Generator>
+		char *random_chars(Converter &c, const char *alphabet, std::size_t size, std::size_t n, char *out, Generator &gen)
+		{
+			typedef typename Converter::result_type T;
+			if (size == 0)
+				Converter::error_policy::raise("Alphabet is empty");
+			if (size == 1)
+			{
+				std::memset(out, alphabet[0], n);
+				return out + n;
+			}
+
+			const T base = (T)size, max = T(1) << (std::numeric_limits<T>::digits / 2);
+			std::size_t k = 1;
+			T power = base;
+			while (power <= max / base)
+				power *= base, ++k;
+
+			for (; n > 0; n -= k)
+			{
+				if (n < k)
+				{
+					k = n;
+					power = base;
+					for (std::size_t i = 1; i < k; ++i)
+						power *= base;
+				}
+				T x = c.convert(power, gen);
+				for (std::size_t i = 0; i < k; ++i, x /= base)
+					*out++ = alphabet[x % base];
+			}
+			return out;
+		}
+	}
+
+	// Writes 'length' characters chosen uniformly from 'alphabet' to out, and returns the end of the output.
+	// c is an entropy_converter, and gen is a uniform random number generator like std::random_device.
+	// The characters of the alphabet are treated as distinct, even if they are repeated.
+	template<typename Converter, typename Generator>
+	char *random_string(Converter &c, const std::string &alphabet, std::size_t length, char *out, Generator &gen)
+	{
+		return detail::random_chars(c, alphabet.data(), alphabet.size(), length, out, gen);
+	}
+
+	// Returns a string of 'length' characters chosen uniformly from 'alphabet'.
+	template<typename Converter, typename Generator>
+	std::string random_string(Converter &c, const std::string &alphabet, std::size_t length, Generator &gen)
+	{
+		std::string result(length, ' ');
+		if (length > 0)
+			random_string(c, alphabet, length, &result[0], gen);
+		return result;
+	}
+
+	// Writes 'count' random tokens of 'length' characters to out, each followed by 'terminator',
+	// so out must have room for count*(length+1) characters. Returns the end of the output.
+	// The digits of each convert() can span several tokens, so short tokens are as efficient as long ones.
+	template<typename Converter, typename Generator>
+	char *fill_tokens(Converter &c, const std::string &alphabet, std::size_t length, std::size_t count, char *out, Generator &gen, char terminator = 0)
+	{
+		// Generate all characters contiguously, then spread them out from the end.
+		random_string(c, alphabet, length * count, out, gen);
+		for (std::size_t i = count; i-- > 0;)
+		{
+			std::memmove(out + i * (length + 1), out + i * length, length);
+			out[i * (length + 1) + length] = terminator;
+		}
+		return out + count * (length + 1);
+	}
+}
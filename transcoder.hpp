@@ -0,0 +1,150 @@
+// Converts a sequence of uniform random digits in one base into uniform random
+// digits in another base, for example rolls of a die into bits or decimal digits.
+// This reads a finite input, such as a recorded log of dice rolls, and produces
+// as many output digits as the input entropy allows.
+//
+// Example: convert a log of d6 rolls (0-5) into bytes.
+//
+// std::vector<int> rolls = ...;
+// std::vector<unsigned> bytes;
+// econv::transcode_digits(rolls.begin(), rolls.end(), 6, 256, std::back_inserter(bytes));
+//
+// auto t = econv::make_digit_transcoder(rolls.begin(), rolls.end(), 6, 10);
+// for (auto digit : t)
+//     std::cout << digit;
+
+#pragma once
+
+#include "entropy_converter.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+namespace econv
+{
+	namespace detail
+	{
+		// Thrown by the source of a digit_transcoder at the end of its input.
+		struct end_of_input {};
+	}
+
+	// An input range of digits in [0,to), read lazily from the digits in [first,last),
+	// which are uniform random integers in [0,from).
+	// T is the result_type of the underlying entropy_converter.
+	template<typename InputIt, typename T = std::uint64_t>
+	class digit_transcoder
+	{
+	public:
+		typedef T result_type;
+
+		digit_transcoder(InputIt first, InputIt last, result_type from, result_type to) :
+			first(first), last(last), from(from), to(to), exhausted(false)
+		{
+			if (from < 2 || to < 2)
+				throw std::range_error("Base must be at least 2");
+		}
+
+		// Reads the next output digit.
+		// Returns false at the end of the input, when there is not enough entropy left for another digit.
+		// Throws std::range_error if an input digit is not in [0,from).
+		bool next(result_type & digit)
+		{
+			if (!exhausted)
+			{
+				try
+				{
+					digit = converter.convert(result_type(0), result_type(to - 1), result_type(0), result_type(from - 1), *this);
+					return true;
+				}
+				catch (const detail::end_of_input &)
+				{
+					// The converter keeps the digits it has read so far.
+					exhausted = true;
+				}
+			}
+			return converter.convert_buffered(to, digit);
+		}
+
+		// Writes up to n output digits to out, and returns the end of the output.
+		template<typename OutputIt>
+		OutputIt read(OutputIt out, std::size_t n = std::numeric_limits<std::size_t>::max())
+		{
+			result_type digit;
+			for (; n > 0 && next(digit); --n)
+				*out++ = digit;
+			return out;
+		}
+
+		// Reads the next input digit. This is the generator used by the converter.
+		result_type operator()()
+		{
+			if (first == last)
+				throw detail::end_of_input();
+			return (result_type)*first++;
+		}
+
+		class iterator
+		{
+		public:
+			typedef std::input_iterator_tag iterator_category;
+			typedef T value_type;
+			typedef std::ptrdiff_t difference_type;
+			typedef const T *pointer;
+			typedef const T &reference;
+
+			iterator() : owner(nullptr), digit(0) {}
+			explicit iterator(digit_transcoder *owner) : owner(owner), digit(0) { ++*this; }
+
+			reference operator*() const { return digit; }
+			pointer operator->() const { return &digit; }
+
+			iterator &operator++()
+			{
+				if (!owner->next(digit))
+					owner = nullptr;
+				return *this;
+			}
+
+			iterator operator++(int)
+			{
+				auto i = *this;
+				++*this;
+				return i;
+			}
+
+			bool operator==(const iterator &other) const { return owner == other.owner; }
+			bool operator!=(const iterator &other) const { return owner != other.owner; }
+
+		private:
+			digit_transcoder *owner;
+			T digit;
+		};
+
+		// Iterates the remaining output digits. The input is read as the iterator advances.
+		iterator begin() { return iterator(this); }
+		iterator end() { return iterator(); }
+
+	private:
+		InputIt first, last;
+		result_type from, to;
+		entropy_converter<T> converter;
+		bool exhausted;
+	};
+
+	template<typename T = std::uint64_t, typename InputIt>
+	digit_transcoder<InputIt, T> make_digit_transcoder(InputIt first, InputIt last, typename std::common_type<T>::type from, typename std::common_type<T>::type to)
+	{
+		return digit_transcoder<InputIt, T>(first, last, from, to);
+	}
+
+	// Converts the base-'from' digits in [first,last) into base-'to' digits, and writes them to out.
+	// Returns the end of the output.
+	template<typename T = std::uint64_t, typename InputIt, typename OutputIt>
+	OutputIt transcode_digits(InputIt first, InputIt last, typename std::common_type<T>::type from, typename std::common_type<T>::type to, OutputIt out)
+	{
+		return digit_transcoder<InputIt, T>(first, last, from, to).read(out);
+	}
+}
@@ -0,0 +1,98 @@
+// C++20 ranges of uniform random numbers using entropy_converter.
+// The outputs are generated lazily, one per element, so a range that is only
+// partly read does not read or discard any extra entropy.
+//
+// Example: write 100 die rolls to a vector.
+//
+// entropy_converter<std::uint64_t> c;
+// std::random_device d;
+// std::vector<int> rolls;
+// std::ranges::copy(econv::views::uniform(c, 1, 6, d) | std::views::take(100), std::back_inserter(rolls));
+//
+// This header requires a standard library with ranges, such as g++ --std=c++20,
+// and is empty otherwise.
+
+#pragma once
+
+#include "entropy_converter.hpp"
+#include <cstddef>
+#include <iterator>
+
+#if __cplusplus >= 202002L || (defined(_MSVC_LANG) && _MSVC_LANG >= 202002L)
+#include <ranges>
+#endif
+
+#if defined(__cpp_lib_ranges)
+namespace econv
+{
+	// An infinite input range of uniform random integers in [a,b], read from gen using converter c.
+	// The converter and the generator must outlive the view.
+	template<typename Converter, typename Result, typename Generator>
+	class uniform_view : public std::ranges::view_interface<uniform_view<Converter, Result, Generator>>
+	{
+	public:
+		uniform_view() : c(nullptr), gen(nullptr), a(0), b(0) { }
+
+		uniform_view(Converter & c, Result a, Result b, Generator & gen) : c(&c), gen(&gen), a(a), b(b)
+		{
+			if (a > b)
+				Converter::error_policy::raise("Invalid output range");
+		}
+
+		class iterator
+		{
+		public:
+			typedef Result value_type;
+			typedef std::ptrdiff_t difference_type;
+			typedef std::input_iterator_tag iterator_concept;
+
+			iterator() : owner(nullptr), ready(false), value(0) { }
+			explicit iterator(const uniform_view *owner) : owner(owner), ready(false), value(0) { }
+
+			// The value is converted when it is first read, so skipped elements read no entropy.
+			Result operator*() const
+			{
+				if (!ready)
+				{
+					value = owner->c->convert(owner->a, owner->b, *owner->gen);
+					ready = true;
+				}
+				return value;
+			}
+
+			iterator &operator++()
+			{
+				ready = false;
+				return *this;
+			}
+
+			void operator++(int) { ++*this; }
+
+			friend bool operator==(const iterator &, std::default_sentinel_t) { return false; }
+
+		private:
+			const uniform_view *owner;
+			mutable bool ready;
+			mutable Result value;
+		};
+
+		iterator begin() const { return iterator(this); }
+		std::default_sentinel_t end() const { return std::default_sentinel; }
+
+	private:
+		Converter *c;
+		Generator *gen;
+		Result a, b;
+	};
+
+	namespace views
+	{
+		// Returns an infinite range of uniform random integers in [a,b], read from gen using converter c.
+		template<typename Converter, typename Result, typename Generator>
+		uniform_view<Converter, Result, Generator> uniform(Converter & c, Result a, Result b, Generator & gen)
+		{
+			return uniform_view<Converter, Result, Generator>(c, a, b, gen);
+		}
+	}
+}
+#endif